@@ -47,6 +47,9 @@ namespace Engine
         size_t resolutionWidth = mSettings.get<size_t>("Display", "resolutionWidth");
         size_t resolutionHeight = mSettings.get<size_t>("Display", "resolutionHeight");
         const bool fullscreen = mSettings.get<bool>("Display", "fullscreen");
+        const bool headless = mSettings.get<bool>("Display", "headless", false);
+        const int32_t spriteCacheMB = mSettings.get<int32_t>("Display", "spriteCacheMB", FARender::Renderer::DEFAULT_SPRITE_CACHE_MB);
+        const std::string spriteDiskCacheDir = mSettings.get<std::string>("Display", "spriteDiskCache", "");
         std::string pathEXE = mSettings.get<std::string>("Game", "PathEXE");
         if (pathEXE == "")
         {
@@ -54,7 +57,7 @@ namespace Engine
         }
 
         Engine::ThreadManager threadManager;
-        FARender::Renderer renderer(resolutionWidth, resolutionHeight, fullscreen);
+        FARender::Renderer renderer(resolutionWidth, resolutionHeight, fullscreen, headless, spriteCacheMB, spriteDiskCacheDir);
         mInputManager = std::make_shared<EngineInputManager>(renderer.getNuklearContext());
         mInputManager->registerKeyboardObserver(this);
         std::thread mainThread(std::bind(&EngineMain::runGameLoop, this, &variables, pathEXE));
@@ -0,0 +1,80 @@
+#include "levelprefetcher.h"
+#include "../falevelgen/levelgen.h"
+#include "../farender/renderer.h"
+#include "../faworld/world.h"
+#include <boost/format.hpp>
+#include <diabloexe/diabloexe.h>
+#include <diabloexe/monster.h>
+#include <faio/faio.h>
+
+namespace Engine
+{
+    LevelPrefetcher::LevelPrefetcher(const FAWorld::World& world) : mWorld(world), mThread(&LevelPrefetcher::run, this) {}
+
+    LevelPrefetcher::~LevelPrefetcher()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStopping = true;
+        }
+        mQueueCV.notify_all();
+
+        mThread.join();
+    }
+
+    void LevelPrefetcher::prefetch(int32_t levelIndex)
+    {
+        if (levelIndex == mLastLevelIndex || levelIndex < 0 || levelIndex >= int32_t(mWorld.getNumLevels()))
+            return;
+
+        mLastLevelIndex = levelIndex;
+
+        FALevelGen::LevelFiles files = FALevelGen::getLevelFiles(levelIndex);
+
+        // What the game thread reads when it builds the level. The cels are left to the sprite decoders, who read them anyway.
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mQueue.push_back(files.tilPath);
+            mQueue.push_back(files.minPath);
+            mQueue.push_back(files.solPath);
+        }
+        mQueueCV.notify_one();
+
+        FARender::Renderer* renderer = FARender::Renderer::get();
+        if (!renderer)
+            return;
+
+        renderer->prefetchTileset(files.celPath, files.minPath);
+        if (!files.specialCelPath.empty())
+            renderer->prefetchImage(files.specialCelPath);
+
+        // Which monsters are placed is only decided when the level is generated, so take all the ones it could have.
+        // These are the animations FAWorld::Monster loads.
+        for (const DiabloExe::Monster* monster : mWorld.mDiabloExe.getMonstersInLevel(levelIndex))
+        {
+            boost::format fmt(monster->cl2Path);
+            for (char animation : {'w', 'n', 'd', 'a', 'h'})
+                renderer->prefetchImage((fmt % animation).str());
+        }
+    }
+
+    void LevelPrefetcher::run()
+    {
+        while (true)
+        {
+            std::string path;
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mQueueCV.wait(lock, [&]() { return mStopping || !mQueue.empty(); });
+
+                if (mStopping)
+                    return;
+
+                path = std::move(mQueue.front());
+                mQueue.pop_front();
+            }
+
+            FAIO::prefetch(path);
+        }
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace FAWorld
+{
+    class World;
+}
+
+namespace Engine
+{
+    ///
+    /// @brief Starts loading a level before the local player gets there
+    ///
+    /// Generating a level, reading its files and loading its tileset and monster sprites all happen in the game tick the
+    /// player changes level. When it looks like they're about to (they've clicked on the stairs, or a change level input
+    /// is queued), prefetch() reads the files the level is built from into FAIO on a background thread, and queues its
+    /// tileset and every monster that could be placed in it for decoding, so by then there's little left to wait for.
+    ///
+    /// Only an optimisation, nothing here changes what ends up in the level.
+    ///
+    class LevelPrefetcher
+    {
+    public:
+        explicit LevelPrefetcher(const FAWorld::World& world);
+        ~LevelPrefetcher();
+
+        void prefetch(int32_t levelIndex); ///< To be called from the game thread
+
+    private:
+        void run();
+
+        const FAWorld::World& mWorld;
+        int32_t mLastLevelIndex = -1;
+
+        std::deque<std::string> mQueue; ///< Paths for the thread to pass to FAIO::prefetch
+        std::mutex mMutex;
+        std::condition_variable mQueueCV;
+        bool mStopping = false;
+        std::thread mThread; ///< Last, so everything it uses exists before it starts
+    };
+}
@@ -10,7 +10,7 @@
 
 namespace Engine
 {
-    LocalInputHandler::LocalInputHandler(FAWorld::World& world) : mWorld(world) {}
+    LocalInputHandler::LocalInputHandler(FAWorld::World& world) : mWorld(world), mLevelPrefetcher(world) {}
 
     void LocalInputHandler::notify(KeyboardInputAction action)
     {
@@ -24,12 +24,14 @@ namespace Engine
             case Engine::KeyboardInputAction::dataChangeLevelUp:
             {
                 mInputs.emplace_back(FAWorld::PlayerInput::ChangeLevelData{FAWorld::PlayerInput::ChangeLevelData::Direction::Up}, player->getId());
+                mLevelPrefetcher.prefetch(player->getLevel()->getPreviousLevel());
                 return;
             }
 
             case Engine::KeyboardInputAction::dataChangeLevelDown:
             {
                 mInputs.emplace_back(FAWorld::PlayerInput::ChangeLevelData{FAWorld::PlayerInput::ChangeLevelData::Direction::Down}, player->getId());
+                mLevelPrefetcher.prefetch(player->getLevel()->getNextLevel());
                 return;
             }
 
@@ -64,6 +66,7 @@ namespace Engine
             case Engine::MouseInputAction::MOUSE_DOWN:
             {
                 auto clickedTile = FARender::Renderer::get()->getTileByScreenPos(mousePosition.x, mousePosition.y, player->getPos());
+                prefetchIfStairs(clickedTile.pos);
 
                 if (auto clickedActor = mWorld.targetedActor(mousePosition))
                 {
@@ -129,6 +132,21 @@ namespace Engine
         }
     }
 
+    void LocalInputHandler::prefetchIfStairs(const Misc::Point& tile)
+    {
+        FAWorld::GameLevel* level = mWorld.getCurrentPlayer()->getLevel();
+        if (!level)
+            return;
+
+        // the stairs are drawn over a few tiles around their position, so allow for clicking any of them
+        auto nearStairs = [&](const Misc::Point& stairs) { return std::abs(tile.x - stairs.x) <= 2 && std::abs(tile.y - stairs.y) <= 2; };
+
+        if (nearStairs(level->downStairsPos()))
+            mLevelPrefetcher.prefetch(level->getNextLevel());
+        else if (!level->isTown() && nearStairs(level->upStairsPos()))
+            mLevelPrefetcher.prefetch(level->getPreviousLevel());
+    }
+
     void LocalInputHandler::addInput(const FAWorld::PlayerInput& input) { mInputs.push_back(input); }
 
     std::vector<FAWorld::PlayerInput> LocalInputHandler::getAndClearInputs()
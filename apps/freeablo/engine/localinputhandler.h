@@ -3,6 +3,7 @@
 #include "../faworld/itemmap.h"
 #include "../faworld/playerinput.h"
 #include "inputobserverinterface.h"
+#include "levelprefetcher.h"
 #include "misc/misc.h"
 #include <vector>
 
@@ -33,7 +34,10 @@ namespace Engine
         const FAWorld::HoverStatus& getHoverStatus() { return mHoverStatus; }
 
     private:
+        void prefetchIfStairs(const Misc::Point& tile);
+
         FAWorld::World& mWorld;
+        LevelPrefetcher mLevelPrefetcher;
         std::vector<FAWorld::PlayerInput> mInputs;
         int32_t mBlockedFramesLeft = 0;
         bool mUnblockInput = true;
@@ -24,6 +24,7 @@ namespace Engine
 
         auto last = std::chrono::system_clock::now();
         size_t numFrames = 0;
+        FARender::SpriteCacheStats lastCacheStats;
 
         while (true)
         {
@@ -45,7 +46,19 @@ namespace Engine
 
             if (duration >= MAXIMUM_DURATION_IN_MS)
             {
-                std::cout << "FPS: " << ((float)numFrames) / (((float)duration) / MAXIMUM_DURATION_IN_MS) << std::endl;
+                Render::RenderStats stats = Render::getRenderStats();
+                std::cout << "FPS: " << ((float)numFrames) / (((float)duration) / MAXIMUM_DURATION_IN_MS) << ", draw calls: " << stats.drawCalls
+                          << ", vertices: " << stats.vertices << std::endl;
+
+                FARender::SpriteCacheStats cacheStats = renderer->getSpriteCacheStats();
+                int64_t lookups = (cacheStats.hits - lastCacheStats.hits) + (cacheStats.misses - lastCacheStats.misses);
+                float hitRate = lookups ? float(cacheStats.hits - lastCacheStats.hits) / lookups : 1.0f;
+                std::cout << "Sprite cache: " << cacheStats.residentBytes / (1024 * 1024) << "/" << cacheStats.budgetBytes / (1024 * 1024) << " MB in "
+                          << cacheStats.residentGroups << " groups, hit rate: " << hitRate * 100.0f
+                          << "%, evictions/s: " << ((float)(cacheStats.evictions - lastCacheStats.evictions)) / (((float)duration) / MAXIMUM_DURATION_IN_MS)
+                          << ", decoding: " << cacheStats.pendingDecodes << std::endl;
+                lastCacheStats = cacheStats;
+
                 numFrames = 0;
                 last = now;
             }
@@ -129,6 +129,10 @@ int fa_main(int argc, char** argv)
     if (!FAIO::init(settings.get<std::string>("Game", "PathMPQ")))
         return EXIT_FAILURE;
 
+    std::string packPath = settings.get<std::string>("Game", "PathPack");
+    if (!packPath.empty() && !FAIO::mountPack(packPath))
+        return EXIT_FAILURE;
+
     Engine::EngineMain engine;
 
     int retval = EXIT_SUCCESS;
@@ -1057,6 +1057,35 @@ namespace FALevelGen
         }
     }
 
+    LevelFiles getLevelFiles(int32_t dLvl)
+    {
+        LevelFiles files;
+
+        if (dLvl == 0)
+        {
+            files.tilPath = "levels/towndata/town.til";
+            files.minPath = "levels/towndata/town.min";
+            files.solPath = "levels/towndata/town.sol";
+            files.celPath = "levels/towndata/town.cel";
+            files.specialCelPath = "levels/towndata/towns.cel";
+            return files;
+        }
+
+        int32_t levelNum = ((dLvl - 1) / 4) + 1;
+        std::string base = "levels/l" + std::to_string(levelNum) + "data/l" + std::to_string(levelNum);
+
+        files.tilPath = base + ".til";
+        files.minPath = base + ".min";
+        files.solPath = base + ".sol";
+        files.celPath = base + ".cel";
+
+        // Special cel images currently only exist for levels 1, 2 and town.
+        if (levelNum == 1 || levelNum == 2)
+            files.specialCelPath = base + "s.cel";
+
+        return files;
+    }
+
     FAWorld::GameLevel* generate(
         FAWorld::World& world, Random::Rng& rng, int32_t width, int32_t height, int32_t dLvl, const DiabloExe::DiabloExe& exe, int32_t previous, int32_t next)
     {
@@ -1147,7 +1176,6 @@ namespace FALevelGen
         // Special cel images currently only exist for levels 1, 2 and town.
         // TODO: load specialCelMap from file.
         std::map<int32_t, int32_t> specialCelMap = {};
-        std::string specialCelPath = "";
         switch (levelNum)
         {
             case 1:
@@ -1171,7 +1199,6 @@ namespace FALevelGen
                     {407, 6},
                     {394, 7},
                 };
-                specialCelPath = "levels/l1data/l1s.cel";
                 break;
             case 2:
                 specialCelMap = {
@@ -1183,34 +1210,19 @@ namespace FALevelGen
                     {552, 5},
                     {16, 5},
                 };
-                specialCelPath = "levels/l2data/l2s.cel";
                 break;
             default:
                 break;
         }
 
-        ss.str("");
-        ss << "levels/l" << levelNum << "data/l" << levelNum << ".cel";
-        std::string celPath = ss.str();
-
-        ss.str("");
-        ss << "levels/l" << levelNum << "data/l" << levelNum << ".til";
-        std::string tilPath = ss.str();
-
-        ss.str("");
-        ss << "levels/l" << levelNum << "data/l" << levelNum << ".min";
-        std::string minPath = ss.str();
-
-        ss.str("");
-        ss << "levels/l" << levelNum << "data/l" << levelNum << ".sol";
-        std::string solPath = ss.str();
+        LevelFiles files = getLevelFiles(dLvl);
 
         Level::Level levelBase(std::move(level),
-                               tilPath,
-                               minPath,
-                               solPath,
-                               celPath,
-                               specialCelPath,
+                               files.tilPath,
+                               files.minPath,
+                               files.solPath,
+                               files.celPath,
+                               files.specialCelPath,
                                specialCelMap,
                                downStairsPoint + Misc::Point(tileset.downStairsXOffset, tileset.downStairsYOffset),
                                upStairsPoint + Misc::Point(tileset.upStairsXOffset, tileset.upStairsYOffset),
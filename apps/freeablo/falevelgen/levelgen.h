@@ -23,6 +23,17 @@ namespace FALevelGen
     class TileSet;
     Level::Dun generateBasic(Random::Rng& rng, TileSet& tileset, int32_t width, int32_t height, int32_t levelNum);
 
+    /// The files a level's tiles are drawn from, which only depend on which dungeon level it is. 0 is the town.
+    struct LevelFiles
+    {
+        std::string tilPath;
+        std::string minPath;
+        std::string solPath;
+        std::string celPath;
+        std::string specialCelPath; ///< Empty for levels with no special cels
+    };
+    LevelFiles getLevelFiles(int32_t dLvl);
+
     FAWorld::GameLevel* generate(
         FAWorld::World& world, Random::Rng& rng, int32_t width, int32_t height, int32_t dLvl, const DiabloExe::DiabloExe& exe, int32_t previous, int32_t next);
 }
@@ -81,7 +81,9 @@ namespace FARender
         return handle;
     }
 
-    Renderer::Renderer(int32_t windowWidth, int32_t windowHeight, bool fullscreen) : mDone(false), mSpriteManager(1024), mWidthHeightTmp(0)
+    Renderer::Renderer(
+        int32_t windowWidth, int32_t windowHeight, bool fullscreen, bool headless, int32_t spriteCacheMB, const std::string& spriteDiskCacheDir)
+        : mDone(false), mSpriteManager(int64_t(spriteCacheMB) * 1024 * 1024, SpriteDecoder::defaultNumThreads(), spriteDiskCacheDir), mWidthHeightTmp(0)
     {
         release_assert(!mRenderer); // singleton, only one instance
 
@@ -91,6 +93,7 @@ namespace FARender
             settings.windowWidth = windowWidth;
             settings.windowHeight = windowHeight;
             settings.fullscreen = fullscreen;
+            settings.headless = headless;
 
             nk_init_default(&mNuklearContext, nullptr);
             mNuklearContext.clip.copy = nullptr;  // nk_sdl_clipbard_copy;
@@ -173,6 +176,10 @@ namespace FARender
 
     FASpriteGroup* Renderer::loadImage(const std::string& path) { return mSpriteManager.get(path); }
 
+    void Renderer::prefetchImage(const std::string& path) { mSpriteManager.prefetch(path); }
+
+    void Renderer::prefetchTileset(const std::string& celPath, const std::string& minPath) { mSpriteManager.prefetchTileset(celPath, minPath); }
+
     FASpriteGroup* Renderer::loadServerImage(uint32_t index) { return mSpriteManager.getByServerSpriteIndex(index); }
 
     void Renderer::fillServerSprite(uint32_t index, const std::string& path) { mSpriteManager.fillServerSprite(index, path); }
@@ -239,9 +246,16 @@ namespace FARender
         Render::clear(0, 0, 0);
 
         // force preloading of sprites by drawing them offscreen
+        // archives loaded by direction only get their first one, the rest load as they're faced
         for (auto id : spritesToPreload)
         {
             Render::SpriteGroup* sprite = mSpriteManager.get(id);
+            if (sprite->numDirections())
+            {
+                mSpriteManager.requestDirection(id, 0);
+                continue;
+            }
+
             for (size_t i = 0; i < sprite->size(); i++)
                 Render::drawSprite(sprite->operator[](i), Render::WIDTH + 10, 0);
         }
@@ -80,7 +80,15 @@ namespace FARender
     public:
         static Renderer* get();
 
-        Renderer(int32_t windowWidth, int32_t windowHeight, bool fullscreen);
+        static constexpr int32_t DEFAULT_SPRITE_CACHE_MB = 256;
+
+        /// @param spriteDiskCacheDir where decoded sprites are kept between runs, empty to not keep them (see SpriteDiskCache)
+        Renderer(int32_t windowWidth,
+                 int32_t windowHeight,
+                 bool fullscreen,
+                 bool headless = false,
+                 int32_t spriteCacheMB = DEFAULT_SPRITE_CACHE_MB,
+                 const std::string& spriteDiskCacheDir = "");
         ~Renderer();
 
         void stop();
@@ -92,6 +100,8 @@ namespace FARender
         void setCurrentState(RenderState* current);
 
         FASpriteGroup* loadImage(const std::string& path);
+        void prefetchImage(const std::string& path);                                  ///< See SpriteManager::prefetch
+        void prefetchTileset(const std::string& celPath, const std::string& minPath); ///< See SpriteManager::prefetchTileset
         FASpriteGroup* loadServerImage(uint32_t index);
         void fillServerSprite(uint32_t index, const std::string& path);
         std::string getPathForIndex(uint32_t index);
@@ -102,6 +112,7 @@ namespace FARender
 
         bool renderFrame(RenderState* state, const std::vector<uint32_t>& spritesToPreload); ///< To be called only by Engine::ThreadManager
         void cleanup();                                                                      ///< To be called only by Engine::ThreadManager
+        SpriteCacheStats getSpriteCacheStats() const { return mSpriteManager.getCacheStats(); } ///< To be called only by Engine::ThreadManager
         Misc::Point cursorSize() const { return mCursorSize; }
 
         nk_context* getNuklearContext() { return &mNuklearContext; }
@@ -6,6 +6,7 @@
 #include <sstream>
 
 #include <cel/celfile.h>
+#include <level/min.h>
 #include <misc/stringops.h>
 #include <numeric>
 
@@ -19,7 +20,10 @@ namespace FARender
         return ret;
     }
 
-    SpriteCache::SpriteCache(uint32_t size) : mNextCacheIndex(1), mCurrentSize(0), mMaxSize(size) {}
+    SpriteCache::SpriteCache(int64_t budgetBytes, int32_t decodeThreads, const std::string& diskCacheDir)
+        : mNextCacheIndex(1), mBudgetBytes(budgetBytes), mDiskCache(diskCacheDir), mDecoder(decodeThreads)
+    {
+    }
 
     SpriteCache::~SpriteCache()
     {
@@ -34,8 +38,8 @@ namespace FARender
             std::vector<std::string> components = Misc::StringUtils::split(path, '&');
 
             std::vector<int32_t> tmpWidth, tmpHeight;
-            int32_t tmpAnimLength;
-            Render::getImageInfo(components[0], tmpWidth, tmpHeight, tmpAnimLength);
+            int32_t tmpAnimLength, tmpNumFrames;
+            Render::getImageInfo(components[0], tmpWidth, tmpHeight, tmpAnimLength, tmpNumFrames);
 
             for (uint32_t i = 1; i < components.size(); i++)
             {
@@ -50,6 +54,7 @@ namespace FARender
                     vanimss >> vAnim;
 
                     tmpAnimLength = (tmpHeight[0] + vAnim - 1) / vAnim;
+                    tmpNumFrames = tmpAnimLength;
                     tmpHeight.resize(tmpAnimLength);
                     tmpWidth.resize(tmpAnimLength);
                     for (int j = 0; j < tmpAnimLength; ++j)
@@ -61,6 +66,7 @@ namespace FARender
                 else if (pair[0] == "convertToSingleTexture")
                 {
                     tmpAnimLength = 1;
+                    tmpNumFrames = 1;
                     tmpWidth = {std::accumulate(tmpWidth.begin(), tmpWidth.end(), 0)};
                     tmpHeight = {*std::max_element(tmpHeight.begin(), tmpHeight.end())};
                 }
@@ -70,9 +76,13 @@ namespace FARender
             uint32_t cacheIndex = newUniqueIndex();
 
             newCacheEntry->init(tmpAnimLength, tmpWidth, tmpHeight, cacheIndex);
+            newCacheEntry->numFrames = tmpNumFrames;
 
             mStrToCache[path] = newCacheEntry;
+
+            std::lock_guard<std::mutex> lock(mIndexMapsMutex);
             mCacheToStr[cacheIndex] = path;
+            mCacheToSpriteGroup[cacheIndex] = newCacheEntry;
         }
 
         return mStrToCache[path];
@@ -86,11 +96,19 @@ namespace FARender
 
         if (!mStrToTilesetCache.count(key))
         {
+            // the pillar sizes are fixed, so only the min needs loading to size the placeholder for the render thread
+            Level::Min min(minPath);
+            std::vector<int32_t> widths(min.size() - 1, 64);
+            std::vector<int32_t> heights(min.size() - 1, 256);
+
             FASpriteGroup* newCacheEntry = allocNewSpriteGroup();
             uint32_t cacheIndex = newUniqueIndex();
-            newCacheEntry->init(0, {}, {}, cacheIndex);
+            newCacheEntry->init(widths.size(), widths, heights, cacheIndex);
             mStrToTilesetCache[key] = newCacheEntry;
+
+            std::lock_guard<std::mutex> lock(mIndexMapsMutex);
             mCacheToTilesetPath[cacheIndex] = TilesetPath(celPath, minPath, top);
+            mCacheToSpriteGroup[cacheIndex] = newCacheEntry;
         }
 
         return mStrToTilesetCache[key];
@@ -98,192 +116,479 @@ namespace FARender
 
     uint32_t SpriteCache::newUniqueIndex() { return mNextCacheIndex++; }
 
-    void SpriteCache::directInsert(Render::SpriteGroup* sprite, uint32_t cacheIndex)
+    void SpriteCache::directInsert(Render::SpriteGroup* sprite, uint32_t cacheIndex) { insert(cacheIndex, sprite, true, nullptr); }
+
+    CacheEntry& SpriteCache::getEntry(uint32_t index)
     {
-        if (mCurrentSize >= mMaxSize)
-            evict();
+        // indices are handed out in order, so this only grows by a few entries at a time
+        if (index >= mCache.size())
+            mCache.resize(index + 1);
 
-        mUsedList.push_front(cacheIndex);
-        mCache[cacheIndex] = CacheEntry(sprite, mUsedList.begin(), true);
+        return mCache[index];
+    }
 
-        mCurrentSize++;
+    void SpriteCache::insert(uint32_t index, Render::SpriteGroup* sprite, bool immortal, std::shared_ptr<SpriteDecodeJob> job)
+    {
+        // placeholders are tiny and short lived, so they don't count
+        int64_t bytes = (sprite && !job) ? sprite->memoryUsage() : 0;
+        while (mResidentBytes + bytes > mBudgetBytes)
+        {
+            if (!evict())
+                break;
+        }
+
+        uint32_t slot;
+        if (!mFreeClockSlots.empty())
+        {
+            slot = mFreeClockSlots.back();
+            mFreeClockSlots.pop_back();
+            mClock[slot] = index;
+        }
+        else
+        {
+            slot = mClock.size();
+            mClock.push_back(index);
+        }
+
+        CacheEntry& entry = getEntry(index);
+        entry.sprite = sprite;
+        entry.loaded = true;
+        entry.immortal = immortal;
+        entry.referenced = true;
+        entry.bytes = bytes;
+        entry.clockSlot = slot;
+        entry.job = std::move(job);
+
+        mResidentBytes += bytes;
+        mResidentGroups++;
     }
 
     Render::SpriteGroup* SpriteCache::get(uint32_t index)
     {
-        if (!mCache.count(index))
+        if (index < mCache.size() && mCache[index].loaded)
         {
-            if (mCurrentSize >= mMaxSize)
-                evict();
+            CacheEntry& entry = mCache[index];
+            entry.referenced = true;
+            mHits++;
+
+            if (entry.job)
+                return finishDecode(index);
 
-            Render::SpriteGroup* newSprite = NULL;
+            if (!entry.directions.empty())
+                updateDirections(index);
 
-            if (mCacheToStr.count(index))
+            return entry.sprite;
+        }
+
+        mMisses++;
+
+        std::string cachePath;
+        TilesetPath tilesetPath;
+        FASpriteGroup* spriteGroup = nullptr;
+        bool isPath = false;
+        bool isTileset = false;
+        {
+            std::lock_guard<std::mutex> lock(mIndexMapsMutex);
+
+            auto pathIt = mCacheToStr.find(index);
+            auto tilesetIt = mCacheToTilesetPath.find(index);
+            if (pathIt != mCacheToStr.end())
             {
-                // TODO: replace mCacheToStr[index] with map.at(), to guarantee thread safety (once we switch to c++11)
-                // until then, it is safe in practice.
-                std::string cachePath = mCacheToStr.at(index);
-
-                std::vector<std::string> components = Misc::StringUtils::split(cachePath, '&');
-                std::string sourcePath = components[0];
-
-                uint32_t vAnim = 0;
-                bool hasTrans = false;
-                bool resize = false;
-                bool convertToSingleTexture = false;
-                bool generateTiledTexture = false;
-                uint32_t tileWidth = 0;
-                uint32_t tileHeight = 0;
-                uint32_t newWidth = 0;
-                uint32_t newHeight = 0;
-                uint32_t r = 0, g = 0, b = 0;
-                int32_t celIndex;
-
-                for (uint32_t i = 1; i < components.size(); i++)
-                {
-                    std::vector<std::string> pair = Misc::StringUtils::split(components[i], '=');
+                cachePath = pathIt->second;
+                isPath = true;
+            }
+            else if (tilesetIt != mCacheToTilesetPath.end())
+            {
+                tilesetPath = tilesetIt->second;
+                isTileset = true;
+            }
 
-                    if (pair[0] == "trans")
-                    {
-                        std::vector<std::string> rgbStr = Misc::StringUtils::split(pair[1], ',');
+            auto groupIt = mCacheToSpriteGroup.find(index);
+            if (groupIt != mCacheToSpriteGroup.end())
+                spriteGroup = groupIt->second;
+        }
 
-                        hasTrans = true;
+        // Plain cels and tilesets are the big ones, so they are decoded off the render thread.
+        // The sprites with extra options are mostly small gui images, and go through SDL surfaces, so they still load here.
+        std::function<Render::SpriteData()> decode;
+        bool byDirection = false;
+        if (isTileset)
+        {
+            int32_t numThreads = mDecoder.threadsPerJob();
+            decode = mDiskCache.wrap(tilesetPath.top ? "tileset top" : "tileset bottom",
+                                     {tilesetPath.celPath, tilesetPath.minPath},
+                                     [tilesetPath, numThreads]() {
+                                         return Render::decodeTilesetSprite(tilesetPath.celPath, tilesetPath.minPath, tilesetPath.top, numThreads);
+                                     });
+        }
+        else if (isPath && (Misc::StringUtils::ciEndsWith(cachePath, ".cel") || Misc::StringUtils::ciEndsWith(cachePath, ".cl2")))
+        {
+            debug_assert(spriteGroup);
+            byDirection = spriteGroup->numFrames > spriteGroup->animLength && spriteGroup->numFrames % spriteGroup->animLength == 0;
 
-                        std::istringstream rss(rgbStr[0]);
-                        rss >> r;
+            if (!byDirection)
+                decode = mDiskCache.wrap("cel", {cachePath}, [cachePath]() { return Render::decodeCelSprite(cachePath); });
+        }
 
-                        std::istringstream gss(rgbStr[1]);
-                        gss >> g;
+        if (byDirection)
+        {
+            // Every subcel has the sizes of the first one
+            std::vector<int32_t> widths(spriteGroup->numFrames), heights(spriteGroup->numFrames);
+            for (int32_t i = 0; i < spriteGroup->numFrames; i++)
+            {
+                widths[i] = spriteGroup->width[i % spriteGroup->animLength];
+                heights[i] = spriteGroup->height[i % spriteGroup->animLength];
+            }
 
-                        std::istringstream bss(rgbStr[2]);
-                        bss >> b;
-                    }
-                    else if (pair[0] == "vanim")
-                    {
-                        std::istringstream vanimss(pair[1]);
+            Render::SpriteGroup* sprite = Render::createPlaceholderSprite(widths, heights);
+            sprite->setNumDirections(spriteGroup->numFrames / spriteGroup->animLength);
 
-                        vanimss >> vAnim;
-                    }
-                    else if (pair[0] == "resize")
-                    {
-                        resize = true;
+            // nothing is decoded until a frame of a direction is asked for
+            sprite->setDirectionRequestHandler([this, index](size_t direction) { requestDirection(index, direction); });
+            insert(index, sprite, false, nullptr);
+            mCache[index].directions.resize(sprite->numDirections());
+            return sprite;
+        }
 
-                        std::vector<std::string> newSize = Misc::StringUtils::split(pair[1], 'x');
+        if (decode)
+        {
+            debug_assert(spriteGroup);
 
-                        std::istringstream wss(newSize[0]);
-                        wss >> newWidth;
+            auto job = mDecoder.push(std::move(decode));
+            mPendingDecodes++;
 
-                        std::istringstream hss(newSize[1]);
-                        hss >> newHeight;
-                    }
-                    else if (pair[0] == "tileSize")
-                    {
-                        std::vector<std::string> tileSize = Misc::StringUtils::split(pair[1], 'x');
+            insert(index, Render::createPlaceholderSprite(spriteGroup->width, spriteGroup->height), false, std::move(job));
+            return finishDecode(index);
+        }
 
-                        std::istringstream wss(tileSize[0]);
-                        wss >> tileWidth;
+        Render::SpriteGroup* newSprite = NULL;
 
-                        std::istringstream hss(tileSize[1]);
-                        hss >> tileHeight;
-                    }
-                    else if (pair[0] == "convertToSingleTexture")
-                    {
-                        convertToSingleTexture = true;
-                    }
-                    else if (pair[0] == "generateTiledTexture")
-                    {
-                        generateTiledTexture = true;
+        if (isPath)
+            newSprite = loadSprite(cachePath);
+        else if (isTileset)
+            newSprite = Render::loadTilesetSprite(tilesetPath.celPath, tilesetPath.minPath, tilesetPath.top);
+        else
+            std::cerr << "ERROR INVALID SPRITE CACHE REQUEST " << index << std::endl;
 
-                        std::vector<std::string> size = Misc::StringUtils::split(pair[1], 'x');
+        insert(index, newSprite, false, nullptr);
+        return newSprite;
+    }
 
-                        std::istringstream wss(size[0]);
-                        wss >> newWidth;
+    Render::SpriteGroup* SpriteCache::finishDecode(uint32_t index)
+    {
+        CacheEntry& entry = mCache[index];
+        if (!entry.job->done)
+            return entry.sprite;
 
-                        std::istringstream hss(size[1]);
-                        hss >> newHeight;
-                    }
-                    else if (pair[0] == "frame")
-                    {
-                        std::istringstream ss(pair[1]);
-                        ss >> celIndex;
-                    }
-                }
+        Render::SpriteGroup* sprite = new Render::SpriteGroup(entry.job->data);
+        bool immortal = entry.immortal;
 
-                if (vAnim != 0)
-                    newSprite = Render::loadVanimSprite(sourcePath, vAnim, hasTrans, r, g, b);
-                else if (resize)
-                    newSprite = Render::loadResizedSprite(sourcePath, newWidth, newHeight, tileWidth, tileHeight, hasTrans, r, g, b);
-                else if (convertToSingleTexture)
-                    newSprite = Render::loadCelToSingleTexture(sourcePath);
-                else if (generateTiledTexture)
-                    newSprite = Render::loadTiledTexture(sourcePath, newWidth, newHeight, hasTrans, r, g, b);
-                else
-                    newSprite = Render::loadSprite(sourcePath, hasTrans, r, g, b);
-            }
-            else if (mCacheToTilesetPath.count(index))
+        remove(index);
+        insert(index, sprite, immortal, nullptr);
+        mCache[index].referenced = true;
+        return sprite;
+    }
+
+    void SpriteCache::requestDirection(uint32_t index, size_t direction)
+    {
+        if (index >= mCache.size() || !mCache[index].loaded)
+            get(index);
+
+        CacheEntry& entry = mCache[index];
+        if (direction >= entry.directions.size())
+            return;
+
+        DirectionState& state = entry.directions[direction];
+        state.referenced = true;
+
+        if (state.job || entry.sprite->isDirectionLoaded(direction))
+            return;
+
+        std::string path;
+        {
+            std::lock_guard<std::mutex> lock(mIndexMapsMutex);
+            path = mCacheToStr[index];
+        }
+
+        int32_t animLength = entry.sprite->animLength();
+        int32_t firstFrame = direction * animLength;
+        std::string key = "cel frames " + std::to_string(firstFrame) + "+" + std::to_string(animLength);
+        auto decode = [path, firstFrame, animLength]() { return Render::decodeCelSprite(path, firstFrame, animLength); };
+        state.job = mDecoder.push(mDiskCache.wrap(key, {path}, decode));
+        mPendingDecodes++;
+    }
+
+    void SpriteCache::updateDirections(uint32_t index)
+    {
+        CacheEntry& entry = mCache[index];
+        Render::SpriteGroup* sprite = entry.sprite;
+        bool loaded = false;
+
+        for (size_t i = 0; i < entry.directions.size(); i++)
+        {
+            DirectionState& direction = entry.directions[i];
+
+            if (sprite->takeDirectionUsed(i))
+                direction.referenced = true;
+
+            if (direction.job && direction.job->done)
             {
-                TilesetPath p = mCacheToTilesetPath[index]; // TODO: same as above
-                newSprite = Render::loadTilesetSprite(p.celPath, p.minPath, p.top);
+                int64_t bytesBefore = sprite->memoryUsage();
+                sprite->loadDirection(i, direction.job->data);
+                direction.bytes = sprite->memoryUsage() - bytesBefore;
+                direction.job.reset();
+                mPendingDecodes--;
+
+                entry.bytes += direction.bytes;
+                mResidentBytes += direction.bytes;
+                loaded = true;
             }
-            else
+        }
+
+        if (loaded)
+        {
+            // Pinned while making room, so the sprite the caller is about to get back can't be evicted from under it
+            bool immortal = entry.immortal;
+            entry.immortal = true;
+
+            while (mResidentBytes > mBudgetBytes)
             {
-                std::cerr << "ERROR INVALID SPRITE CACHE REQUEST " << index << std::endl;
+                if (!evict())
+                    break;
             }
 
-            mUsedList.push_front(index);
-            mCache[index] = CacheEntry(newSprite, mUsedList.begin(), false);
-            mCurrentSize++;
+            entry.immortal = immortal;
         }
-        else
+    }
+
+    bool SpriteCache::dropColdDirections(uint32_t index)
+    {
+        CacheEntry& entry = mCache[index];
+        bool dropped = false;
+
+        for (size_t i = 0; i < entry.directions.size(); i++)
         {
-            moveToFront(index);
+            DirectionState& direction = entry.directions[i];
+
+            if (!direction.referenced && entry.sprite->isDirectionLoaded(i))
+            {
+                entry.sprite->unloadDirection(i);
+                entry.bytes -= direction.bytes;
+                mResidentBytes -= direction.bytes;
+                direction.bytes = 0;
+                dropped = true;
+            }
+
+            direction.referenced = false;
         }
 
-        return mCache[index].sprite;
+        return dropped;
     }
 
-    void SpriteCache::moveToFront(uint32_t index)
+    Render::SpriteGroup* SpriteCache::loadSprite(const std::string& cachePath)
     {
-        mUsedList.erase(mCache.at(index).it);
-        mUsedList.push_front(index);
-        mCache[index].it = mUsedList.begin();
+        std::vector<std::string> components = Misc::StringUtils::split(cachePath, '&');
+        std::string sourcePath = components[0];
+
+        uint32_t vAnim = 0;
+        bool hasTrans = false;
+        bool resize = false;
+        bool convertToSingleTexture = false;
+        bool generateTiledTexture = false;
+        uint32_t tileWidth = 0;
+        uint32_t tileHeight = 0;
+        uint32_t newWidth = 0;
+        uint32_t newHeight = 0;
+        uint32_t r = 0, g = 0, b = 0;
+        int32_t celIndex;
+
+        for (uint32_t i = 1; i < components.size(); i++)
+        {
+            std::vector<std::string> pair = Misc::StringUtils::split(components[i], '=');
+
+            if (pair[0] == "trans")
+            {
+                std::vector<std::string> rgbStr = Misc::StringUtils::split(pair[1], ',');
+
+                hasTrans = true;
+
+                std::istringstream rss(rgbStr[0]);
+                rss >> r;
+
+                std::istringstream gss(rgbStr[1]);
+                gss >> g;
+
+                std::istringstream bss(rgbStr[2]);
+                bss >> b;
+            }
+            else if (pair[0] == "vanim")
+            {
+                std::istringstream vanimss(pair[1]);
+
+                vanimss >> vAnim;
+            }
+            else if (pair[0] == "resize")
+            {
+                resize = true;
+
+                std::vector<std::string> newSize = Misc::StringUtils::split(pair[1], 'x');
+
+                std::istringstream wss(newSize[0]);
+                wss >> newWidth;
+
+                std::istringstream hss(newSize[1]);
+                hss >> newHeight;
+            }
+            else if (pair[0] == "tileSize")
+            {
+                std::vector<std::string> tileSize = Misc::StringUtils::split(pair[1], 'x');
+
+                std::istringstream wss(tileSize[0]);
+                wss >> tileWidth;
+
+                std::istringstream hss(tileSize[1]);
+                hss >> tileHeight;
+            }
+            else if (pair[0] == "convertToSingleTexture")
+            {
+                convertToSingleTexture = true;
+            }
+            else if (pair[0] == "generateTiledTexture")
+            {
+                generateTiledTexture = true;
+
+                std::vector<std::string> size = Misc::StringUtils::split(pair[1], 'x');
+
+                std::istringstream wss(size[0]);
+                wss >> newWidth;
+
+                std::istringstream hss(size[1]);
+                hss >> newHeight;
+            }
+            else if (pair[0] == "frame")
+            {
+                std::istringstream ss(pair[1]);
+                ss >> celIndex;
+            }
+        }
+
+        if (vAnim != 0)
+            return Render::loadVanimSprite(sourcePath, vAnim, hasTrans, r, g, b);
+        else if (resize)
+            return Render::loadResizedSprite(sourcePath, newWidth, newHeight, tileWidth, tileHeight, hasTrans, r, g, b);
+        else if (convertToSingleTexture)
+            return Render::loadCelToSingleTexture(sourcePath);
+        else if (generateTiledTexture)
+            return Render::loadTiledTexture(sourcePath, newWidth, newHeight, hasTrans, r, g, b);
+        else
+            return Render::loadSprite(sourcePath, hasTrans, r, g, b);
     }
 
     void SpriteCache::setImmortal(uint32_t index, bool immortal)
     {
-        get(index);
+        // Not get() for something already resident, that could swap a placeholder for the real sprite
+        // and leave the caller holding a deleted pointer it got just before this.
+        if (index >= mCache.size() || !mCache[index].loaded)
+            get(index);
+
         mCache[index].immortal = immortal;
     }
 
-    void SpriteCache::evict()
+    bool SpriteCache::evict()
     {
-        std::list<uint32_t>::reverse_iterator it;
-
-        for (it = mUsedList.rbegin(); it != mUsedList.rend(); it++)
+        // Two full sweeps are enough to clear every referenced flag and come back round to an entry
+        size_t maxSteps = mClock.size() * 2;
+        for (size_t step = 0; step < maxSteps; step++)
         {
-            if (!mCache[*it].immortal)
-                break;
+            uint32_t slot = mClockHand;
+            mClockHand = (mClockHand + 1) % mClock.size();
+
+            uint32_t index = mClock[slot];
+            if (index == 0)
+                continue;
+
+            CacheEntry& entry = mCache[index];
+            if (entry.immortal)
+                continue;
+
+            if (entry.referenced)
+            {
+                entry.referenced = false;
+
+                if (!entry.directions.empty() && dropColdDirections(index))
+                {
+                    mEvictions++;
+                    return true;
+                }
+
+                continue;
+            }
+
+            remove(index);
+            mEvictions++;
+            return true;
         }
 
-        release_assert(it != mUsedList.rend() && "no evictable slots found. This should never happen");
+        return false;
+    }
+
+    void SpriteCache::remove(uint32_t index)
+    {
+        CacheEntry& entry = mCache[index];
+
+        if (entry.sprite)
+        {
+            entry.sprite->destroy();
+            delete entry.sprite;
+        }
 
-        CacheEntry toEvict = mCache[*it];
+        // a queued decode is dropped when its last reference goes, one in progress just finishes into nothing
+        if (entry.job)
+            mPendingDecodes--;
+        for (const auto& direction : entry.directions)
+        {
+            if (direction.job)
+                mPendingDecodes--;
+        }
 
-        toEvict.sprite->destroy();
-        delete toEvict.sprite;
+        mResidentBytes -= entry.bytes;
+        mResidentGroups--;
 
-        mCache.erase(*it);
-        mUsedList.erase(--(it.base()));
-        mCurrentSize--;
+        mClock[entry.clockSlot] = 0;
+        mFreeClockSlots.push_back(entry.clockSlot);
+        entry = CacheEntry();
     }
 
     void SpriteCache::clear()
     {
-        for (std::list<uint32_t>::iterator it = mUsedList.begin(); it != mUsedList.end(); it++)
+        for (uint32_t index : mClock)
         {
-            mCache[*it].sprite->destroy();
-            delete mCache[*it].sprite;
+            if (index != 0)
+                remove(index);
         }
+
+        mCache.clear();
+        mClock.clear();
+        mFreeClockSlots.clear();
+        mClockHand = 0;
+        mResidentBytes = 0;
+        mResidentGroups = 0;
+        mPendingDecodes = 0;
+    }
+
+    SpriteCacheStats SpriteCache::getStats() const
+    {
+        SpriteCacheStats stats;
+        stats.residentBytes = mResidentBytes;
+        stats.budgetBytes = mBudgetBytes;
+        stats.residentGroups = mResidentGroups;
+        stats.hits = mHits;
+        stats.misses = mMisses;
+        stats.evictions = mEvictions;
+        stats.pendingDecodes = mPendingDecodes;
+        stats.diskCacheHits = mDiskCache.hits();
+        stats.diskCacheMisses = mDiskCache.misses();
+        return stats;
     }
 
     std::string SpriteCache::getPathForIndex(uint32_t index)
@@ -2,8 +2,9 @@
 #pragma once
 
 #include <atomic>
-#include <list>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <stdlib.h>
 #include <string>
 #include <utility>
@@ -12,6 +13,9 @@
 #include <fa_nuklear.h>
 #include <render/render.h>
 
+#include "spritedecoder.h"
+#include "spritediskcache.h"
+
 namespace FARender
 {
     class Renderer;
@@ -21,6 +25,7 @@ namespace FARender
     public:
         bool isValid() { return spriteCacheIndex != 0; }
         int32_t getAnimLength() { return animLength; }
+        int32_t getNumFrames() { return numFrames; }
         int32_t getWidth(int frame = 0) const { return width[frame]; }
         int32_t getHeight(int frame = 0) const { return height[frame]; }
         int32_t getCacheIndex() { return spriteCacheIndex; }
@@ -30,6 +35,7 @@ namespace FARender
         void init(int32_t _animLength, const std::vector<int32_t>& _width, const std::vector<int32_t>& _height, int32_t _spriteCacheIndex)
         {
             animLength = _animLength;
+            numFrames = _animLength;
             width = _width;
             height = _height;
             spriteCacheIndex = _spriteCacheIndex;
@@ -43,6 +49,7 @@ namespace FARender
         }
 
         int32_t animLength = 0;
+        int32_t numFrames = 0; ///< animLength times the number of subcels, for archives
         std::vector<int32_t> width = {};
         std::vector<int32_t> height = {};
         int32_t spriteCacheIndex = 0;
@@ -64,15 +71,37 @@ namespace FARender
         TilesetPath() {}
     };
 
-    struct CacheEntry
+    struct DirectionState
     {
-        Render::SpriteGroup* sprite;
-        std::list<uint32_t>::iterator it;
-        bool immortal;
+        std::shared_ptr<SpriteDecodeJob> job; ///< Set while the direction is being decoded
+        bool referenced = false;              ///< Like CacheEntry::referenced, but cleared only when the whole entry is passed over
+        int64_t bytes = 0;
+    };
 
-        CacheEntry(Render::SpriteGroup* _sprite, std::list<uint32_t>::iterator _it, bool _immortal) : sprite(_sprite), it(_it), immortal(_immortal) {}
+    struct CacheEntry
+    {
+        Render::SpriteGroup* sprite = nullptr;
+        bool loaded = false;     ///< Set even if loading failed, so a bad request is only reported once
+        bool immortal = false;
+        bool referenced = false; ///< Cleared as the clock hand passes, entries that stay unreferenced for a full sweep get evicted
+        int64_t bytes = 0;
+        uint32_t clockSlot = 0;
+        std::shared_ptr<SpriteDecodeJob> job; ///< Set while the sprite is still being decoded, sprite is a placeholder until then
+        std::vector<DirectionState> directions; ///< Empty unless the sprite is an archive loaded one direction at a time
+    };
 
-        CacheEntry() {}
+    /// Counters are totals since the cache was created, sample them twice to get rates
+    struct SpriteCacheStats
+    {
+        int64_t residentBytes = 0;
+        int64_t budgetBytes = 0;
+        int32_t residentGroups = 0;
+        int64_t hits = 0;
+        int64_t misses = 0;
+        int64_t evictions = 0;
+        int32_t pendingDecodes = 0;
+        int64_t diskCacheHits = 0;
+        int64_t diskCacheMisses = 0;
     };
 
     ///
@@ -82,10 +111,29 @@ namespace FARender
     /// get(uint32_t index) method is used to get a Render::SpriteGroup pointer in the render thread, actual image loading is done lazily here.
     /// The index value comes from FASpriteGroup.spriteCacheIndex
     ///
+    /// Cache indices are small dense integers, so the render thread side of the cache is a plain vector indexed by them,
+    /// with CLOCK eviction (an approximation of LRU where a hit only sets a flag), so get() never allocates once warmed up.
+    ///
+    /// The size limit is in bytes of texture memory rather than a number of sprite groups, as a single cursor frame
+    /// and a full tileset differ in size by several orders of magnitude. Immortal sprites can push the cache over budget,
+    /// as they are never evicted.
+    ///
+    /// Cels and tilesets are decoded by a SpriteDecoder pool. Until that finishes, get(uint32_t) returns a placeholder with
+    /// invisible frames of the right sizes, then the first get() after it finishes uploads the result, and returns a different pointer.
+    /// With a SpriteDiskCache directory set, the decode threads look there before decoding anything.
+    ///
+    /// Archives (monster and player cl2s) have a subcel for each of 8 directions, and a monster rarely faces more than one or two
+    /// of them while it's on screen. So their directions are decoded separately, starting the moment a frame of one is first asked for,
+    /// and uploaded by the next get(),
+    /// and when the cache needs room, the directions of a sprite that is still in use that weren't drawn for a whole sweep of the
+    /// clock hand are freed on their own.
+    ///
     class SpriteCache
     {
     public:
-        SpriteCache(uint32_t size);
+        /// @param decodeThreads 0 to decode on the render thread, synchronously
+        /// @param diskCacheDir where to keep decoded sprites between runs, empty to not keep them
+        SpriteCache(int64_t budgetBytes, int32_t decodeThreads = SpriteDecoder::defaultNumThreads(), const std::string& diskCacheDir = "");
         ~SpriteCache();
 
         FASpriteGroup* get(const std::string& path); ///< To be called from the game thread
@@ -107,6 +155,11 @@ namespace FARender
         /// @brief To be called from the render thread
         Render::SpriteGroup* get(uint32_t index);
 
+        /// Starts decoding a direction of an archive that is loaded one direction at a time, unless it's loaded or loading already.
+        /// Drawing a frame of the direction does this too, this is for preloading one before it's drawn.
+        /// @brief To be called from the render thread
+        void requestDirection(uint32_t index, size_t direction);
+
         /// Used when we need to guarantee that a sprite will not be evicted for a period of time
         /// @brief To be called from the render thread
         void setImmortal(uint32_t index, bool immortal);
@@ -120,25 +173,44 @@ namespace FARender
 
         void clear(); //< To be called from the render thread
 
+        SpriteCacheStats getStats() const; ///< To be called from the render thread
+
     private:
-        void moveToFront(uint32_t index);
-        void evict();
+        CacheEntry& getEntry(uint32_t index);
+        void insert(uint32_t index, Render::SpriteGroup* sprite, bool immortal, std::shared_ptr<SpriteDecodeJob> job);
+        void remove(uint32_t index);
+        Render::SpriteGroup* finishDecode(uint32_t index);
+        void updateDirections(uint32_t index);  ///< Uploads finished directions
+        bool dropColdDirections(uint32_t index); ///< Returns true if anything was freed
+        Render::SpriteGroup* loadSprite(const std::string& cachePath);
+        bool evict(); ///< Returns false if everything resident is immortal
 
         std::map<std::string, FASpriteGroup*> mStrToCache;
-        std::map<uint32_t, std::string> mCacheToStr;
-
         std::map<std::string, FASpriteGroup*> mStrToTilesetCache;
-        std::map<uint32_t, TilesetPath> mCacheToTilesetPath;
 
-        std::map<uint32_t, uint32_t> mCacheToSprite;
+        /// Written by the game thread, read by the render thread on a miss
+        std::mutex mIndexMapsMutex;
+        std::map<uint32_t, std::string> mCacheToStr;
+        std::map<uint32_t, TilesetPath> mCacheToTilesetPath;
+        std::map<uint32_t, FASpriteGroup*> mCacheToSpriteGroup;
 
-        std::map<uint32_t, CacheEntry> mCache;
-        std::list<uint32_t> mUsedList;
+        std::vector<CacheEntry> mCache; ///< Indexed by cache index, only touched by the render thread
+        std::vector<uint32_t> mClock;   ///< Cache indices of the loaded entries, 0 for a free slot
+        std::vector<uint32_t> mFreeClockSlots;
+        uint32_t mClockHand = 0;
 
         std::atomic<uint32_t> mNextCacheIndex;
 
-        uint32_t mCurrentSize;
-        uint32_t mMaxSize;
+        int64_t mResidentBytes = 0;
+        int64_t mBudgetBytes;
+        int32_t mResidentGroups = 0;
+        int64_t mHits = 0;
+        int64_t mMisses = 0;
+        int64_t mEvictions = 0;
+        int32_t mPendingDecodes = 0;
+
+        SpriteDiskCache mDiskCache;
+        SpriteDecoder mDecoder; ///< Last, so its threads are stopped before anything they use goes away
 
         static constexpr uint32_t SPRITEGROUP_STORE_BLOCK_SIZE = 256;
         std::vector<FASpriteGroup*> mSpriteGroupStore;
@@ -0,0 +1,82 @@
+#include "spritedecoder.h"
+
+#include <algorithm>
+
+namespace FARender
+{
+    SpriteDecoder::SpriteDecoder(int32_t numThreads)
+    {
+        for (int32_t i = 0; i < numThreads; i++)
+            mThreads.emplace_back(&SpriteDecoder::run, this);
+    }
+
+    SpriteDecoder::~SpriteDecoder()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStopping = true;
+        }
+        mQueueCV.notify_all();
+
+        for (auto& thread : mThreads)
+            thread.join();
+    }
+
+    int32_t SpriteDecoder::defaultNumThreads()
+    {
+        // leave room for the game and render threads
+        int32_t cores = std::thread::hardware_concurrency();
+        return std::max(1, std::min(4, cores - 2));
+    }
+
+    int32_t SpriteDecoder::threadsPerJob() const
+    {
+        int32_t cores = std::max(1, int32_t(std::thread::hardware_concurrency()));
+        return std::max(1, cores / std::max(1, numThreads()));
+    }
+
+    std::shared_ptr<SpriteDecodeJob> SpriteDecoder::push(std::function<Render::SpriteData()> decode)
+    {
+        auto job = std::make_shared<SpriteDecodeJob>();
+        job->decode = std::move(decode);
+
+        if (mThreads.empty())
+        {
+            job->data = job->decode();
+            job->done = true;
+            return job;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mQueue.push_back(job);
+        }
+        mQueueCV.notify_one();
+
+        return job;
+    }
+
+    void SpriteDecoder::run()
+    {
+        while (true)
+        {
+            std::shared_ptr<SpriteDecodeJob> job;
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mQueueCV.wait(lock, [&]() { return mStopping || !mQueue.empty(); });
+
+                if (mStopping)
+                    return;
+
+                job = mQueue.front().lock();
+                mQueue.pop_front();
+            }
+
+            if (!job)
+                continue;
+
+            job->data = job->decode();
+            job->done = true;
+        }
+    }
+}
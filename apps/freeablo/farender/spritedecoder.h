@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <render/render.h>
+
+namespace FARender
+{
+    struct SpriteDecodeJob
+    {
+        std::function<Render::SpriteData()> decode;
+        Render::SpriteData data;       ///< Only valid once done is set
+        std::atomic_bool done{false};
+    };
+
+    ///
+    /// @brief Pool of threads that decode sprites for SpriteCache, so the render thread only has to upload them
+    ///
+    /// Jobs are dropped without running if everyone else has let go of them by the time a thread gets to them,
+    /// so the cache can just forget about a sprite it evicts while it is still queued.
+    ///
+    class SpriteDecoder
+    {
+    public:
+        explicit SpriteDecoder(int32_t numThreads);
+        ~SpriteDecoder();
+
+        std::shared_ptr<SpriteDecodeJob> push(std::function<Render::SpriteData()> decode); ///< To be called from the render thread
+
+        int32_t numThreads() const { return mThreads.size(); }
+        static int32_t defaultNumThreads();
+
+        /// How many threads one job can split its own work over (eg. decodeTilesetSprite) without the
+        /// pool as a whole using more than one per core, when all of its threads are doing the same
+        int32_t threadsPerJob() const;
+
+    private:
+        void run();
+
+        std::vector<std::thread> mThreads;
+        std::deque<std::weak_ptr<SpriteDecodeJob>> mQueue;
+        std::mutex mMutex;
+        std::condition_variable mQueueCV;
+        bool mStopping = false;
+    };
+}
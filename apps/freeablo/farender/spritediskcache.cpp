@@ -0,0 +1,239 @@
+#include "spritediskcache.h"
+
+#include <boost/filesystem.hpp>
+#include <cstdio>
+#include <cstring>
+#include <faio/fafileobject.h>
+#include <iomanip>
+#include <iostream>
+#include <misc/md5.h>
+#include <sstream>
+#include <thread>
+
+namespace FARender
+{
+    namespace
+    {
+        struct EntryHeader
+        {
+            char magic[4];
+            uint32_t version;
+            int32_t animLength;
+            uint32_t numFrames;
+        };
+
+        struct EntryFrame
+        {
+            int32_t width;
+            int32_t height;
+        };
+
+        const char ENTRY_MAGIC[4] = {'F', 'A', 'S', 'D'};
+    }
+
+    constexpr uint32_t SpriteDiskCache::DECODER_VERSION;
+
+    SpriteDiskCache::SpriteDiskCache(const std::string& directory) : mDirectory(directory)
+    {
+        if (mDirectory.empty())
+            return;
+
+        boost::system::error_code error;
+        boost::filesystem::create_directories(mDirectory, error);
+        if (error)
+        {
+            std::cerr << "Could not create sprite disk cache directory " << mDirectory << ": " << error.message() << ", not caching sprites" << std::endl;
+            mDirectory.clear();
+        }
+    }
+
+    std::function<Render::SpriteData()>
+    SpriteDiskCache::wrap(const std::string& key, const std::vector<std::string>& sourcePaths, std::function<Render::SpriteData()> decode)
+    {
+        if (!enabled())
+            return decode;
+
+        return [this, key, sourcePaths, decode]() { return load(key, sourcePaths, decode); };
+    }
+
+    Render::SpriteData
+    SpriteDiskCache::load(const std::string& key, const std::vector<std::string>& sourcePaths, const std::function<Render::SpriteData()>& decode)
+    {
+        std::string path = entryPath(key, sourcePaths);
+
+        Render::SpriteData data;
+        if (read(path, data))
+        {
+            mHits++;
+            return data;
+        }
+
+        mMisses++;
+        data = decode();
+        write(path, data);
+        return data;
+    }
+
+    std::string SpriteDiskCache::entryPath(const std::string& key, const std::vector<std::string>& sourcePaths) const
+    {
+        Misc::md5_state_t state;
+        Misc::md5_byte_t digest[16];
+        md5_init(&state);
+
+        auto append = [&](const void* data, size_t size) { md5_append(&state, reinterpret_cast<const Misc::md5_byte_t*>(data), size); };
+
+        append(&DECODER_VERSION, sizeof(DECODER_VERSION));
+        append(key.c_str(), key.size() + 1);
+
+        // the paths matter as well as the contents, eg. they pick the palette a cel is decoded with
+        for (const auto& sourcePath : sourcePaths)
+        {
+            append(sourcePath.c_str(), sourcePath.size() + 1);
+
+            std::string contentsDigest = sourceDigest(sourcePath);
+            append(contentsDigest.data(), contentsDigest.size());
+        }
+
+        md5_finish(&state, digest);
+
+        std::stringstream name;
+        for (int32_t i = 0; i < 16; i++)
+            name << std::hex << std::setw(2) << std::setfill('0') << int32_t(digest[i]);
+
+        return (boost::filesystem::path(mDirectory) / (name.str() + ".fasd")).string();
+    }
+
+    std::string SpriteDiskCache::sourceDigest(const std::string& sourcePath) const
+    {
+        {
+            std::lock_guard<std::mutex> lock(mSourceDigestsMutex);
+            auto it = mSourceDigests.find(sourcePath);
+            if (it != mSourceDigests.end())
+                return it->second;
+        }
+
+        // Not hashed under the lock, so other files can be looked up meanwhile. Two threads might both hash the
+        // same file the first time, but they get the same answer.
+        std::string result;
+        FAIO::FAFileObject file(sourcePath);
+        if (file.isValid())
+        {
+            std::vector<uint8_t> contents(file.FAsize());
+            file.FAfread(contents.data(), 1, contents.size());
+
+            Misc::md5_state_t state;
+            Misc::md5_byte_t digest[16];
+            md5_init(&state);
+            md5_append(&state, contents.data(), contents.size());
+            md5_finish(&state, digest);
+            result.assign(reinterpret_cast<const char*>(digest), sizeof(digest));
+        }
+
+        std::lock_guard<std::mutex> lock(mSourceDigestsMutex);
+        mSourceDigests[sourcePath] = result;
+        return result;
+    }
+
+    bool SpriteDiskCache::read(const std::string& path, Render::SpriteData& data)
+    {
+        FILE* f = fopen(path.c_str(), "rb");
+        if (!f)
+            return false;
+
+        std::vector<uint8_t> buffer;
+        if (fseek(f, 0, SEEK_END) == 0)
+        {
+            long size = ftell(f);
+            if (size > 0 && fseek(f, 0, SEEK_SET) == 0)
+            {
+                buffer.resize(size);
+                if (fread(buffer.data(), 1, buffer.size(), f) != buffer.size())
+                    buffer.clear();
+            }
+        }
+        fclose(f);
+
+        // Anything that doesn't add up is treated as a miss, and gets overwritten
+        size_t pos = 0;
+        auto take = [&](void* dest, size_t size) {
+            if (buffer.size() - pos < size)
+                return false;
+            if (size == 0)
+                return true;
+            memcpy(dest, buffer.data() + pos, size);
+            pos += size;
+            return true;
+        };
+
+        EntryHeader header;
+        if (!take(&header, sizeof(header)) || memcmp(header.magic, ENTRY_MAGIC, sizeof(ENTRY_MAGIC)) != 0 || header.version != DECODER_VERSION)
+            return false;
+
+        for (size_t i = 0; i < 256; i++)
+        {
+            if (!take(&data.palette[i], sizeof(Cel::Colour)))
+                return false;
+        }
+
+        std::vector<EntryFrame> frames(header.numFrames);
+        if (header.numFrames > (buffer.size() - pos) / sizeof(EntryFrame) || !take(frames.data(), frames.size() * sizeof(EntryFrame)))
+            return false;
+
+        data.animLength = header.animLength;
+        data.frames.resize(frames.size());
+        for (size_t i = 0; i < frames.size(); i++)
+        {
+            Render::SpriteData::Frame& frame = data.frames[i];
+            frame.width = frames[i].width;
+            frame.height = frames[i].height;
+
+            size_t size = size_t(frame.width) * size_t(frame.height) * 2;
+            if (frame.width < 0 || frame.height < 0 || size > buffer.size() - pos)
+                return false;
+
+            frame.pixels.resize(size);
+            take(frame.pixels.data(), size);
+        }
+
+        return pos == buffer.size();
+    }
+
+    void SpriteDiskCache::write(const std::string& path, const Render::SpriteData& data)
+    {
+        // Written under a temporary name then renamed, so a reader (maybe in another instance of the game) never sees half an entry
+        std::string tempPath = path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+
+        FILE* f = fopen(tempPath.c_str(), "wb");
+        if (!f)
+            return;
+
+        EntryHeader header;
+        memcpy(header.magic, ENTRY_MAGIC, sizeof(ENTRY_MAGIC));
+        header.version = DECODER_VERSION;
+        header.animLength = data.animLength;
+        header.numFrames = data.frames.size();
+
+        bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+
+        for (size_t i = 0; i < 256; i++)
+            ok = ok && fwrite(&data.palette[i], sizeof(Cel::Colour), 1, f) == 1;
+
+        for (const auto& frame : data.frames)
+        {
+            EntryFrame entryFrame = {frame.width, frame.height};
+            ok = ok && fwrite(&entryFrame, sizeof(entryFrame), 1, f) == 1;
+        }
+
+        for (const auto& frame : data.frames)
+            ok = ok && fwrite(frame.pixels.data(), 1, frame.pixels.size(), f) == frame.pixels.size();
+
+        ok = fclose(f) == 0 && ok;
+
+        boost::system::error_code error;
+        if (ok)
+            boost::filesystem::rename(tempPath, path, error);
+
+        if (!ok || error)
+            boost::filesystem::remove(tempPath, error);
+    }
+}
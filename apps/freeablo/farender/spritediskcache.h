@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <render/render.h>
+
+namespace FARender
+{
+    ///
+    /// @brief Optional store of decoded sprites on disk, so later runs can skip decoding them
+    ///
+    /// Entries are named after an md5 of the source files' paths and contents, what was decoded from them, and DECODER_VERSION.
+    /// A changed source file or decoder just means a different name, so stale entries are never looked at again rather
+    /// than needing to be cleaned out. An entry is a small header, the palette, the frame sizes, then all the frame pixels
+    /// back to back, so it is read with one call and could be mapped straight into memory.
+    ///
+    /// All methods can be called from any thread.
+    ///
+    class SpriteDiskCache
+    {
+    public:
+        /// Bump this whenever the decoders, or the compositing of tilesets, would produce different pixels
+        static constexpr uint32_t DECODER_VERSION = 1;
+
+        /// @param directory where entries are kept, created if it doesn't exist. Empty disables the cache.
+        explicit SpriteDiskCache(const std::string& directory);
+
+        bool enabled() const { return !mDirectory.empty(); }
+
+        /// Wraps decode so it first looks for an entry, and stores its result if there wasn't one.
+        /// Returns decode unchanged if the cache is disabled.
+        /// @param key what decode produces from sourcePaths, eg. "tileset top"
+        std::function<Render::SpriteData()>
+        wrap(const std::string& key, const std::vector<std::string>& sourcePaths, std::function<Render::SpriteData()> decode);
+
+        int64_t hits() const { return mHits; }
+        int64_t misses() const { return mMisses; }
+
+    private:
+        Render::SpriteData load(const std::string& key, const std::vector<std::string>& sourcePaths, const std::function<Render::SpriteData()>& decode);
+        std::string entryPath(const std::string& key, const std::vector<std::string>& sourcePaths) const;
+        std::string sourceDigest(const std::string& sourcePath) const;
+        static bool read(const std::string& path, Render::SpriteData& data);
+        static void write(const std::string& path, const Render::SpriteData& data);
+
+        std::string mDirectory;
+
+        /// md5 of each source file's contents, worked out the first time it is needed. The game data doesn't change
+        /// while we are running, and a cel decoded by direction looks its entries up once per direction.
+        mutable std::unordered_map<std::string, std::string> mSourceDigests;
+        mutable std::mutex mSourceDigestsMutex;
+        std::atomic<int64_t> mHits{0};
+        std::atomic<int64_t> mMisses{0};
+    };
+}
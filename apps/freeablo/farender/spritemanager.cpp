@@ -4,7 +4,10 @@
 
 namespace FARender
 {
-    SpriteManager::SpriteManager(uint32_t cacheSize) : mCache(cacheSize) {}
+    SpriteManager::SpriteManager(int64_t cacheBudgetBytes, int32_t decodeThreads, const std::string& diskCacheDir)
+        : mCache(cacheBudgetBytes, decodeThreads, diskCacheDir)
+    {
+    }
 
     ///////////////////////////
     // game thread functions //
@@ -78,6 +81,23 @@ namespace FARender
         return sprites.size() != 0;
     }
 
+    void SpriteManager::prefetch(const std::string& path)
+    {
+        uint32_t index = mCache.get(path)->spriteCacheIndex;
+        mSpritesAlredyPreloaded.insert(index);
+        mSpritesNeedingPreloading.push_back(index);
+    }
+
+    void SpriteManager::prefetchTileset(const std::string& celPath, const std::string& minPath)
+    {
+        for (bool top : {true, false})
+        {
+            uint32_t index = mCache.getTileset(celPath, minPath, top)->spriteCacheIndex;
+            mSpritesAlredyPreloaded.insert(index);
+            mSpritesNeedingPreloading.push_back(index);
+        }
+    }
+
     void SpriteManager::addToPreloadList(uint32_t index)
     {
         if (mSpritesAlredyPreloaded.count(index) == 0)
@@ -111,7 +131,9 @@ namespace FARender
 
     void SpriteManager::setImmortal(uint32_t index, bool immortal)
     {
-        get(index);
+        if (mRawCache.count(index))
+            get(index);
+
         mCache.setImmortal(index, immortal);
     }
 
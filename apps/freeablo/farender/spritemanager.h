@@ -22,7 +22,7 @@ namespace FARender
     class SpriteManager : public Render::SpriteCacheBase
     {
     public:
-        SpriteManager(uint32_t cacheSize);
+        SpriteManager(int64_t cacheBudgetBytes, int32_t decodeThreads = SpriteDecoder::defaultNumThreads(), const std::string& diskCacheDir = "");
 
         //////////////////////////////////
         // game thread public functions //
@@ -52,6 +52,12 @@ namespace FARender
 
         bool getAndClearSpritesNeedingPreloading(std::vector<uint32_t>& sprites); ///< To be called from the game thread
 
+        /// Queues a sprite to be decoded ahead of it being drawn. Unlike get(), this queues it again if it's been loaded before,
+        /// as it may have been evicted since.
+        /// @brief To be called from the game thread
+        void prefetch(const std::string& path);
+        void prefetchTileset(const std::string& celPath, const std::string& minPath); ///< Both the top and bottom halves
+
         /////////////////////////////
         // render thread functions //
         /////////////////////////////
@@ -64,8 +70,12 @@ namespace FARender
 
         void setImmortal(uint32_t index, bool immortal); ///< To be called from the render thread
 
+        void requestDirection(uint32_t index, size_t direction) { mCache.requestDirection(index, direction); } ///< To be called from the render thread
+
         void clear(); ///< To be called from the render thread
 
+        SpriteCacheStats getCacheStats() const { return mCache.getStats(); } ///< To be called from the render thread
+
     private:
         SpriteCache mCache;
 
@@ -1,38 +1,20 @@
 #include "findpath.h"
 #include "gamelevel.h"
+#include <algorithm>
 #include <cmath>
-#include <cstring>
-#include <misc/array2d.h>
-#include <misc/stdhashes.h>
-#include <queue>
 
 namespace
 {
     const int STRAIGHT_WEIGHT = 10;
     const int DIAGONAL_WEIGHT = 14;
 
+    const int32_t MAX_ITERATIONS = 1000;
+
     int distanceCost(const Misc::Point& a, const Misc::Point& b) { return (a.x != b.x && a.y != b.y) ? DIAGONAL_WEIGHT : STRAIGHT_WEIGHT; }
 }
 
 namespace FAWorld
 {
-    template <typename T, typename Number = size_t> struct PriorityQueue
-    {
-        typedef std::pair<Number, T> PQElement;
-        std::priority_queue<PQElement, std::vector<PQElement>, std::greater<PQElement>> elements;
-
-        inline bool empty() { return elements.empty(); }
-
-        inline void put(T item, Number priority) { elements.emplace(priority, item); }
-
-        inline T get()
-        {
-            T best_item = elements.top().second;
-            elements.pop();
-            return best_item;
-        }
-    };
-
     bool inBounds(GameLevelImpl* level, Misc::Point location)
     {
         int x = location.x;
@@ -61,7 +43,7 @@ namespace FAWorld
         return result;
     }
 
-    size_t heuristic(Misc::Point a, Misc::Point b)
+    int32_t heuristic(Misc::Point a, Misc::Point b)
     {
         auto dx = abs(b.x - a.x);
         auto dy = abs(b.y - a.y);
@@ -72,69 +54,294 @@ namespace FAWorld
         return straight * STRAIGHT_WEIGHT + diagonal * DIAGONAL_WEIGHT;
     }
 
-    bool AStarSearch(GameLevelImpl* level,
-                     const Actor* actor,
-                     Misc::Point start,
-                     Misc::Point& goal,
-                     std::unordered_map<Misc::Point, Misc::Point>& came_from,
-                     bool findAdjacent)
+    namespace
+    {
+        int32_t sign(int32_t value) { return (value > 0) - (value < 0); }
+
+        // puts the lowest priority on top of the heap, breaking ties the same way std::pair would
+        template <typename Node> bool lowerPriority(const Node& a, const Node& b)
+        {
+            return a.priority > b.priority || (a.priority == b.priority && b.point < a.point);
+        }
+
+        /// Walks from a jump point in one direction until it reaches the goal or a tile a path might turn at, returning
+        /// that tile, or Misc::Point::invalid() if it runs into a wall first.
+        ///
+        /// Diagonal moves are allowed between two walls, as neighbors() allows them, so a tile is only worth stopping at
+        /// when a wall beside it hides a neighbour that can't be reached as cheaply any other way (a "forced" neighbour).
+        class Jumper
+        {
+        public:
+            Jumper(GameLevelImpl* level, const Actor* actor, const Misc::Point& goal, bool stopAdjacent)
+                : mLevel(level), mActor(actor), mGoal(goal), mStopAdjacent(stopAdjacent), mWidth(level->width()), mHeight(level->height())
+            {
+            }
+
+            bool passable(int32_t x, int32_t y) const
+            {
+                return x >= 0 && x < mWidth && y >= 0 && y < mHeight && mLevel->isPassable(Misc::Point(x, y), mActor);
+            }
+
+            bool isGoal(int32_t x, int32_t y) const
+            {
+                if (mStopAdjacent)
+                    return abs(mGoal.x - x) <= 1 && abs(mGoal.y - y) <= 1;
+                return x == mGoal.x && y == mGoal.y;
+            }
+
+            Misc::Point jump(Misc::Point from, int32_t dx, int32_t dy) const
+            {
+                if (dx != 0 && dy != 0)
+                    return jumpDiagonal(from, dx, dy);
+                return jumpStraight(from, dx, dy);
+            }
+
+        private:
+            Misc::Point jumpStraight(Misc::Point from, int32_t dx, int32_t dy) const
+            {
+                int32_t x = from.x;
+                int32_t y = from.y;
+
+                while (true)
+                {
+                    x += dx;
+                    y += dy;
+
+                    if (!passable(x, y))
+                        return Misc::Point::invalid();
+                    if (isGoal(x, y))
+                        return {x, y};
+
+                    // the walls either side of a straight move are at (x + dy, y + dx) and (x - dy, y - dx)
+                    if ((!passable(x + dy, y + dx) && passable(x + dx + dy, y + dy + dx)) || (!passable(x - dy, y - dx) && passable(x + dx - dy, y + dy - dx)))
+                        return {x, y};
+                }
+            }
+
+            Misc::Point jumpDiagonal(Misc::Point from, int32_t dx, int32_t dy) const
+            {
+                int32_t x = from.x;
+                int32_t y = from.y;
+
+                while (true)
+                {
+                    x += dx;
+                    y += dy;
+
+                    if (!passable(x, y))
+                        return Misc::Point::invalid();
+                    if (isGoal(x, y))
+                        return {x, y};
+
+                    if ((!passable(x - dx, y) && passable(x - dx, y + dy)) || (!passable(x, y - dy) && passable(x + dx, y - dy)))
+                        return {x, y};
+
+                    // a diagonal move has to stop wherever one of its straight parts would find something
+                    if (jumpStraight({x, y}, dx, 0).isValid() || jumpStraight({x, y}, 0, dy).isValid())
+                        return {x, y};
+                }
+            }
+
+            GameLevelImpl* mLevel;
+            const Actor* mActor;
+            Misc::Point mGoal;
+            bool mStopAdjacent;
+            int32_t mWidth;
+            int32_t mHeight;
+        };
+    }
+
+    void PathFindContext::beginSearch(int32_t width, int32_t height)
+    {
+        size_t size = size_t(width) * size_t(height);
+
+        if (width != mWidth || height != mHeight)
+        {
+            mWidth = width;
+            mHeight = height;
+            mStamps.assign(size, 0);
+            mCosts.resize(size);
+            mParents.resize(size);
+            mGeneration = 0;
+        }
+
+        mGeneration++;
+        if (mGeneration == 0)
+        {
+            // wrapped around, so old stamps could match again
+            std::fill(mStamps.begin(), mStamps.end(), 0);
+            mGeneration = 1;
+        }
+
+        mFrontier.clear();
+    }
+
+    void PathFindContext::push(const Misc::Point& point, int32_t priority)
     {
-        auto goalPassable = level->isPassable(goal, actor);
-        PriorityQueue<Misc::Point> frontier;
-        frontier.put(start, 0);
-        came_from[start] = start;
+        mFrontier.push_back({priority, point});
+        std::push_heap(mFrontier.begin(), mFrontier.end(), lowerPriority<Node>);
+    }
 
-        static Misc::Array2D<int32_t> costSoFar;
-        costSoFar.resize(level->width(), level->height());
-        memset(costSoFar.data(), 0xff, level->width() * level->height() * sizeof(int32_t));
+    Misc::Point PathFindContext::pop()
+    {
+        std::pop_heap(mFrontier.begin(), mFrontier.end(), lowerPriority<Node>);
+        Misc::Point point = mFrontier.back().point;
+        mFrontier.pop_back();
+        return point;
+    }
+
+    bool PathFindContext::relax(const Misc::Point& point, int32_t cost, int32_t parentIndex)
+    {
+        int32_t i = index(point);
+        if (mStamps[i] == mGeneration && mCosts[i] <= cost)
+            return false;
 
-        costSoFar.get(start.x, start.y) = 0;
+        mStamps[i] = mGeneration;
+        mCosts[i] = cost;
+        mParents[i] = parentIndex;
+        return true;
+    }
 
+    bool PathFindContext::aStar(GameLevelImpl* level, const Actor* actor, const Misc::Point& goal, bool stopAdjacent, Misc::Point& reached)
+    {
         int32_t iterations = 0;
-        while (!frontier.empty() && iterations < 1000)
+        while (!mFrontier.empty() && iterations < MAX_ITERATIONS)
         {
             iterations++;
-            Misc::Point current = frontier.get();
+            Misc::Point current = pop();
 
-            // Early exit
-            if (current == goal)
+            if (current == goal || (stopAdjacent && abs(goal.x - current.x) <= 1 && abs(goal.y - current.y) <= 1))
+            {
+                reached = current;
                 return true;
-            if (findAdjacent || !goalPassable)
+            }
+
+            int32_t currentIndex = index(current);
+            int32_t currentCost = mCosts[currentIndex];
+
+            for (int32_t dy = -1; dy <= 1; dy++)
             {
-                if (abs(goal.x - current.x) <= 1 && abs(goal.y - current.y) <= 1)
+                for (int32_t dx = -1; dx <= 1; dx++)
                 {
-                    goal = current;
-                    return true;
+                    Misc::Point next(current.x + dx, current.y + dy);
+                    if ((dx == 0 && dy == 0) || next.x < 0 || next.x >= mWidth || next.y < 0 || next.y >= mHeight)
+                        continue;
+
+                    int32_t nextIndex = index(next);
+                    int32_t newCost = currentCost + distanceCost(current, next);
+
+                    // cheaper to rule out than calling isPassable
+                    if (mStamps[nextIndex] == mGeneration && mCosts[nextIndex] <= newCost)
+                        continue;
+
+                    if (level->isPassable(next, actor) && relax(next, newCost, currentIndex))
+                        push(next, newCost + heuristic(next, goal));
                 }
             }
+        }
 
-            for (const auto& next : neighbors(level, actor, current))
+        return false;
+    }
+
+    bool PathFindContext::jumpPoint(
+        GameLevelImpl* level, const Actor* actor, const Misc::Point& start, const Misc::Point& goal, bool stopAdjacent, Misc::Point& reached)
+    {
+        Jumper jumper(level, actor, goal, stopAdjacent);
+
+        // Each iteration expands a jump point, which stands for a whole run of tiles, so the same limit goes much further than A*'s
+        int32_t iterations = 0;
+        while (!mFrontier.empty() && iterations < MAX_ITERATIONS)
+        {
+            iterations++;
+            Misc::Point current = pop();
+
+            if (current == goal || (stopAdjacent && abs(goal.x - current.x) <= 1 && abs(goal.y - current.y) <= 1))
             {
-                auto new_cost = costSoFar.get(current.x, current.y) + distanceCost(current, next);
+                reached = current;
+                return true;
+            }
+
+            int32_t currentIndex = index(current);
+            int32_t currentCost = mCosts[currentIndex];
+            Misc::Point parent = pointAt(mParents[currentIndex]);
+
+            // (dx, dy) pairs of the directions to jump in
+            int32_t directions[8][2];
+            int32_t numDirections = 0;
+            auto addDirection = [&](int32_t dx, int32_t dy) {
+                directions[numDirections][0] = dx;
+                directions[numDirections][1] = dy;
+                numDirections++;
+            };
+
+            int32_t dx = sign(current.x - parent.x);
+            int32_t dy = sign(current.y - parent.y);
 
-                if (costSoFar.get(next.x, next.y) == -1 || new_cost < costSoFar.get(next.x, next.y))
+            if (current == start)
+            {
+                // the start has no parent, so nothing can be pruned
+                for (int32_t y = -1; y <= 1; y++)
                 {
-                    costSoFar.get(next.x, next.y) = new_cost;
-                    frontier.put(next, new_cost + heuristic(next, goal));
-                    came_from[next] = current;
+                    for (int32_t x = -1; x <= 1; x++)
+                    {
+                        if (x != 0 || y != 0)
+                            addDirection(x, y);
+                    }
                 }
             }
+            else if (dx != 0 && dy != 0)
+            {
+                addDirection(dx, dy);
+                addDirection(dx, 0);
+                addDirection(0, dy);
+                if (!jumper.passable(current.x - dx, current.y))
+                    addDirection(-dx, dy);
+                if (!jumper.passable(current.x, current.y - dy))
+                    addDirection(dx, -dy);
+            }
+            else
+            {
+                addDirection(dx, dy);
+
+                // the walls either side of a straight move are at (x + dy, y + dx) and (x - dy, y - dx)
+                if (!jumper.passable(current.x + dy, current.y + dx))
+                    addDirection(dx + dy, dy + dx);
+                if (!jumper.passable(current.x - dy, current.y - dx))
+                    addDirection(dx - dy, dy - dx);
+            }
+
+            for (int32_t i = 0; i < numDirections; i++)
+            {
+                // the way from a jump point to the next is always a straight or diagonal line, so costs the same as the heuristic
+                Misc::Point next = jumper.jump(current, directions[i][0], directions[i][1]);
+                if (next.isValid() && relax(next, currentCost + heuristic(current, next), currentIndex))
+                    push(next, mCosts[index(next)] + heuristic(next, goal));
+            }
         }
 
         return false;
     }
 
-    Misc::Points reconstructPath(Misc::Point start, Misc::Point goal, std::unordered_map<Misc::Point, Misc::Point>& cameFrom)
+    Misc::Points PathFindContext::reconstructPath(const Misc::Point& start, const Misc::Point& reached) const
     {
         Misc::Points path;
-        Misc::Point current = goal;
-        path.push_back(current);
+        path.push_back(reached);
+
+        Misc::Point current = reached;
         while (current != start)
         {
-            current = cameFrom[current];
-            if (current != start)
-                path.push_back(current);
+            Misc::Point parent = pointAt(mParents[index(current)]);
+            int32_t dx = sign(parent.x - current.x);
+            int32_t dy = sign(parent.y - current.y);
+
+            while (current != parent)
+            {
+                current = Misc::Point(current.x + dx, current.y + dy);
+                if (current != start)
+                    path.push_back(current);
+            }
         }
+
         path.push_back(start);
         std::reverse(path.begin(), path.end());
         return path;
@@ -142,13 +349,39 @@ namespace FAWorld
 
     Misc::Points pathFind(GameLevelImpl* level, const Actor* actor, const Misc::Point& start, const Misc::Point& goal, bool& bArrivable, bool findAdjacent)
     {
-        auto adjustedGoal = goal;
-        std::unordered_map<Misc::Point, Misc::Point> cameFrom;
+        thread_local PathFindContext context;
+        return pathFind(context, level, actor, start, goal, bArrivable, findAdjacent);
+    }
+
+    Misc::Points pathFind(PathFindContext& context,
+                          GameLevelImpl* level,
+                          const Actor* actor,
+                          const Misc::Point& start,
+                          const Misc::Point& goal,
+                          bool& bArrivable,
+                          bool findAdjacent)
+    {
+        bArrivable = false;
+        if (!inBounds(level, start))
+            return {};
+
+        context.beginSearch(level->width(), level->height());
+
+        bool stopAdjacent = findAdjacent || !level->isPassable(goal, actor);
+
+        int32_t startIndex = context.index(start);
+        context.relax(start, 0, startIndex);
+        context.push(start, 0);
+
+        Misc::Point reached;
+        if (context.mode() == PathFindMode::JumpPoint)
+            bArrivable = context.jumpPoint(level, actor, start, goal, stopAdjacent, reached);
+        else
+            bArrivable = context.aStar(level, actor, goal, stopAdjacent, reached);
 
-        bArrivable = AStarSearch(level, actor, start, adjustedGoal, cameFrom, findAdjacent);
         if (!bArrivable)
             return {};
 
-        return reconstructPath(start, adjustedGoal, cameFrom);
+        return context.reconstructPath(start, reached);
     }
 }
@@ -1,12 +1,86 @@
 #pragma once
 
 #include <misc/point.h>
+#include <vector>
 
 namespace FAWorld
 {
     class GameLevelImpl;
     class Actor;
 
+    enum class PathFindMode
+    {
+        /// Plain A*, which gives up on long paths across open levels. Only kept to compare against.
+        AStar,
+        /// Jump point search, which only expands the tiles where a path might turn, so it finds long paths across open
+        /// levels that A* gives up on. The paths it finds are just as short, but can be a different one of several equally short paths.
+        JumpPoint
+    };
+
+    ///
+    /// @brief Scratch space for pathFind, kept between searches so they don't allocate once it has grown to fit the level
+    ///
+    /// Each tile's cost and parent are only meaningful when its stamp matches the current search's generation, so
+    /// starting a search just bumps the generation instead of clearing the arrays.
+    ///
+    class PathFindContext
+    {
+    public:
+        explicit PathFindContext(PathFindMode mode = PathFindMode::JumpPoint) : mMode(mode) {}
+
+        PathFindMode mode() const { return mMode; }
+
+    private:
+        struct Node
+        {
+            int32_t priority;
+            Misc::Point point;
+        };
+
+        friend Misc::Points pathFind(PathFindContext& context,
+                                     GameLevelImpl* level,
+                                     const Actor* actor,
+                                     const Misc::Point& start,
+                                     const Misc::Point& goal,
+                                     bool& bArrivable,
+                                     bool findAdjacent);
+
+        void beginSearch(int32_t width, int32_t height);
+        void push(const Misc::Point& point, int32_t priority);
+        Misc::Point pop();
+
+        /// Records that point can be reached at cost from parent, returning false if it's already known to be reachable for as little
+        bool relax(const Misc::Point& point, int32_t cost, int32_t parentIndex);
+
+        int32_t index(const Misc::Point& point) const { return point.x + point.y * mWidth; }
+        Misc::Point pointAt(int32_t index) const { return {index % mWidth, index / mWidth}; }
+
+        bool aStar(GameLevelImpl* level, const Actor* actor, const Misc::Point& goal, bool stopAdjacent, Misc::Point& reached);
+        bool jumpPoint(GameLevelImpl* level, const Actor* actor, const Misc::Point& start, const Misc::Point& goal, bool stopAdjacent, Misc::Point& reached);
+
+        /// Every tile from start to reached, filling in the straight and diagonal runs between jump points
+        Misc::Points reconstructPath(const Misc::Point& start, const Misc::Point& reached) const;
+
+        PathFindMode mMode;
+        int32_t mWidth = 0;
+        int32_t mHeight = 0;
+        uint32_t mGeneration = 0;
+        std::vector<uint32_t> mStamps;
+        std::vector<int32_t> mCosts;
+        std::vector<int32_t> mParents; ///< Index of the tile each tile was reached from
+        std::vector<Node> mFrontier;   ///< Binary min heap on priority
+    };
+
     Misc::Points neighbors(GameLevelImpl* level, const Actor* actor, const Misc::Point& location);
+
+    /// Uses a jump point search context per thread. This decides where actors walk, so it must not depend on anything local
+    /// to one player in a multiplayer game.
     Misc::Points pathFind(GameLevelImpl* level, const Actor* actor, const Misc::Point& start, const Misc::Point& goal, bool& bArrivable, bool findAdjacent);
+    Misc::Points pathFind(PathFindContext& context,
+                          GameLevelImpl* level,
+                          const Actor* actor,
+                          const Misc::Point& start,
+                          const Misc::Point& goal,
+                          bool& bArrivable,
+                          bool findAdjacent);
 }
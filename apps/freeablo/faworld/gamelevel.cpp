@@ -5,6 +5,7 @@
 #include "itemmap.h"
 #include "missile/missile.h"
 #include "world.h"
+#include <algorithm>
 #include <boost/make_unique.hpp>
 #include <diabloexe/diabloexe.h>
 #include <misc/assert.h>
@@ -12,12 +13,13 @@
 namespace FAWorld
 {
     GameLevel::GameLevel(World& world, Level::Level&& level, size_t levelIndex)
-        : mWorld(world), mLevel(std::move(level)), mLevelIndex(levelIndex), mItemMap(new ItemMap(this))
+        : mWorld(world), mLevel(std::move(level)), mLevelIndex(levelIndex), mActorMap2D(mLevel.width(), mLevel.height()), mItemMap(new ItemMap(this))
     {
     }
 
     GameLevel::GameLevel(World& world, FASaveGame::GameLoader& loader)
-        : mWorld(world), mLevel(Level::Level(loader)), mLevelIndex(loader.load<int32_t>()), mItemMap(new ItemMap(loader, this))
+        : mWorld(world), mLevel(Level::Level(loader)), mLevelIndex(loader.load<int32_t>()), mActorMap2D(mLevel.width(), mLevel.height()),
+          mItemMap(new ItemMap(loader, this))
     {
         release_assert(loader.currentlyLoadingLevel == nullptr);
         loader.currentlyLoadingLevel = this;
@@ -116,33 +118,37 @@ namespace FAWorld
 
     void GameLevel::actorMapInsert(Actor* actor)
     {
-        Actor* blocking = nullptr;
-        if (mActorMap2D.count(actor->getPos().current()))
-            blocking = mActorMap2D[actor->getPos().current()];
-        debug_assert(blocking == actor || blocking == nullptr || blocking->isDead());
-
-        mActorMap2D[actor->getPos().current()] = actor;
+        Misc::Point current = actor->getPos().current();
+        if (mActorMap2D.pointIsValid(current.x, current.y))
+        {
+            Actor*& cell = mActorMap2D.get(current.x, current.y);
+            debug_assert(cell == actor || cell == nullptr || cell->isDead());
+            cell = actor;
+        }
 
         if (actor->getPos().isMoving())
         {
-            if (mActorMap2D.count(actor->getPos().next()))
-                blocking = mActorMap2D[actor->getPos().next()];
-            debug_assert(blocking == actor || blocking == nullptr || blocking->isDead());
-
-            mActorMap2D[actor->getPos().next()] = actor;
+            Misc::Point next = actor->getPos().next();
+            if (mActorMap2D.pointIsValid(next.x, next.y))
+            {
+                Actor*& cell = mActorMap2D.get(next.x, next.y);
+                debug_assert(cell == actor || cell == nullptr || cell->isDead());
+                cell = actor;
+            }
         }
     }
 
     void GameLevel::actorMapRemove(const Actor* actor, Misc::Point point)
     {
-#ifndef NDEBUG
-        Actor* currentlyPresent = mActorMap2D[point];
-        debug_assert(currentlyPresent == actor || currentlyPresent == nullptr);
-#endif
-        mActorMap2D.erase(point);
+        if (!mActorMap2D.pointIsValid(point.x, point.y))
+            return;
+
+        Actor*& cell = mActorMap2D.get(point.x, point.y);
+        debug_assert(cell == actor || cell == nullptr);
+        cell = nullptr;
     }
 
-    void GameLevel::actorMapClear() { mActorMap2D.clear(); }
+    void GameLevel::actorMapClear() { std::fill(mActorMap2D.begin(), mActorMap2D.end(), nullptr); }
 
     void GameLevel::actorMapRefresh()
     {
@@ -191,7 +197,7 @@ namespace FAWorld
         if (forActor && forActor->mIsTowner)
             return true;
 
-        if (point.x < 0 || point.x >= width() || point.y < 0 || point.y >= height() || !mLevel.get(point).passable())
+        if (!mLevel.isPassable(point))
             return false;
 
         FAWorld::Actor* actor = getActorAt(point);
@@ -200,11 +206,10 @@ namespace FAWorld
 
     Actor* GameLevel::getActorAt(const Misc::Point& point) const
     {
-        auto it = mActorMap2D.find(point);
-        if (it == mActorMap2D.end())
+        if (!mActorMap2D.pointIsValid(point.x, point.y))
             return nullptr;
 
-        return it->second;
+        return mActorMap2D.get(point.x, point.y);
     }
 
     static Cel::Colour friendHoverColor() { return {180, 110, 110, true}; }
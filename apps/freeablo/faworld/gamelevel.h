@@ -4,8 +4,7 @@
 #include "itemmap.h" // TODO: remove, only included for the Tile type
 #include "misc/point.h"
 #include <level/level.h>
-#include <misc/stdhashes.h>
-#include <unordered_map>
+#include <misc/array2d.h>
 
 namespace FARender
 {
@@ -118,7 +117,7 @@ namespace FAWorld
         int32_t mLevelIndex = 0;
 
         std::vector<Actor*> mActors;
-        std::unordered_map<Misc::Point, Actor*> mActorMap2D; ///< Map of points to actors.
+        Misc::Array2D<Actor*> mActorMap2D; ///< The actor on each tile, or nullptr.
         ///< Where an actor straddles two squares, they shall be placed in both.
         friend class FARender::Renderer;
 
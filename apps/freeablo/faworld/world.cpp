@@ -191,12 +191,14 @@ namespace FAWorld
         std::map<int32_t, int32_t> specialCelMap = {
             {357, 1}, {128, 5}, {129, 6}, {127, 7}, {116, 8}, {156, 9}, {157, 10}, {155, 11}, {161, 12}, {159, 13}, {213, 14}, {211, 15}, {216, 16}, {215, 17}};
 
+        FALevelGen::LevelFiles files = FALevelGen::getLevelFiles(0);
+
         Level::Level townLevelBase(Level::Dun::getTown(sector1, sector2, sector3, sector4),
-                                   "levels/towndata/town.til",
-                                   "levels/towndata/town.min",
-                                   "levels/towndata/town.sol",
-                                   "levels/towndata/town.cel",
-                                   "levels/towndata/towns.cel",
+                                   files.tilPath,
+                                   files.minPath,
+                                   files.solPath,
+                                   files.celPath,
+                                   files.specialCelPath,
                                    specialCelMap,
                                    Misc::Point(25u, 29u),
                                    Misc::Point(75u, 68u),
@@ -73,6 +73,7 @@ namespace FAWorld
 
         void setLevel(int32_t levelNum);
         GameLevel* getLevel(size_t level);
+        size_t getNumLevels() const { return mLevels.size(); } ///< Including ones that haven't been generated yet
         void insertLevel(size_t level, GameLevel* gameLevel);
         void regenerateStoreItems();
 
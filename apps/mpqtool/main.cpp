@@ -1,39 +1,123 @@
 
+#include <fstream>
 #include <iostream>
 
 #include <stdint.h>
 
 #include <stdio.h>
 
-#include <faio/fafileobject.h>
+#include <faio/faio.h>
+#include <faio/pack.h>
+#include <misc/stringops.h>
 
-int main(int argc, char** argv)
+static void printUsage(const char* name)
 {
-    if (argc != 3)
+    std::cout << "The Freeablo MPQ tool can be used in two ways: " << std::endl;
+    std::cout << name << " <path to file in MPQ> <output file on file system>" << std::endl;
+    std::cout << "    Extracts the specified file within the Diablo MPQ file to the output file." << std::endl;
+    std::cout << name << " --pack <list file> <output pack> [--lz4]" << std::endl;
+    std::cout << "    Extracts every file named in the list file (one path per line) into a single pack, which freeablo reads ";
+    std::cout << "ahead of the MPQ when PathPack is set. --lz4 compresses the files in it." << std::endl;
+}
+
+static int extractFile(const std::string& mpqPath, const std::string& outputPath)
+{
+    FAIO::FileSpan file = FAIO::mapFile(mpqPath);
+    if (!file.isValid())
+        return 1;
+
+    FILE* output = fopen(outputPath.c_str(), "wb");
+    if (!output)
     {
-        std::cout << "The Freeablo MPQ tool accepts two parameters: " << std::endl;
-        std::cout << argv[0] << " <path to file in MPQ> <output file on file system>" << std::endl;
-        std::cout << "The tool extracts the specified file within the Diablo MPQ file and extracts it to ";
-        std::cout << "the output file as requested." << std::endl;
+        std::cerr << "Failed to open " << outputPath << " for writing" << std::endl;
         return 1;
     }
 
-    FAIO::init();
+    bool ok = fwrite(file.data(), 1, file.size(), output) == file.size();
+    ok = fclose(output) == 0 && ok;
+
+    return ok ? 0 : 1;
+}
+
+static int makePack(const std::string& listFilePath, const std::string& outputPath, bool compress)
+{
+    std::ifstream listFile(listFilePath);
+    if (!listFile)
+    {
+        std::cerr << "Failed to open " << listFilePath << std::endl;
+        return 1;
+    }
 
-    FAIO::FAFileObject file(argv[1]);
-    FILE* output = fopen(argv[2], "w");
+    FAIO::PackWriter pack(outputPath, compress);
+    if (!pack.isOpen())
+        return 1;
 
-    int read = 1;
-    uint8_t buffer[1024];
+    int32_t numFiles = 0;
+    uint64_t totalSize = 0;
 
-    while (read > 0)
+    std::string path;
+    while (std::getline(listFile, path))
     {
-        read = file.FAfread(buffer, 1, sizeof(buffer));
-        fwrite(buffer, 1, read, output);
+        if (!path.empty() && path.back() == '\r')
+            path.pop_back();
+
+        if (path.empty())
+            continue;
+
+        // FAfopen refuses to open these, see the Cel tests
+        std::string lower = path;
+        Misc::StringUtils::toLower(lower);
+        if (Misc::StringUtils::endsWith(lower, "banner2.dun") || Misc::StringUtils::endsWith(lower, "dmagew.cl2") ||
+            Misc::StringUtils::endsWith(lower, "unravw.cel"))
+        {
+            std::cout << "Skipping broken file " << path << std::endl;
+            continue;
+        }
+
+        // list files usually cover every version of the game, so plenty won't be in this one
+        if (!FAIO::exists(path))
+            continue;
+
+        FAIO::FileSpan file = FAIO::mapFile(path);
+        if (!file.isValid())
+            return 1;
+
+        if (!pack.add(path, file.data(), file.size()))
+        {
+            std::cout << "Skipping " << path << ", it's a duplicate or couldn't be written" << std::endl;
+            continue;
+        }
+
+        numFiles++;
+        totalSize += file.size();
     }
 
-    fclose(output);
+    if (!pack.finish())
+    {
+        std::cerr << "Failed to write " << outputPath << std::endl;
+        return 1;
+    }
 
-    FAIO::FAFileObject::quit();
+    std::cout << "Packed " << numFiles << " files, " << totalSize / 1024 << "KB, into " << outputPath << std::endl;
     return 0;
 }
+
+int main(int argc, char** argv)
+{
+    bool pack = argc >= 2 && std::string(argv[1]) == "--pack";
+    bool compress = argc == 5 && std::string(argv[4]) == "--lz4";
+
+    if (pack ? !(argc == 4 || compress) : argc != 3)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (!FAIO::init())
+        return 1;
+
+    int retval = pack ? makePack(argv[2], argv[3], compress) : extractFile(argv[1], argv[2]);
+
+    FAIO::quit();
+    return retval;
+}
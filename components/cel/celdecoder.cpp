@@ -1,28 +1,42 @@
 #include "celdecoder.h"
+#include "celkernels.h"
+#include <algorithm>
 #include <boost/algorithm/string/case_conv.hpp>
 #include <boost/range/adaptor/transformed.hpp>
+#include <cstring>
 #include <faio/fafileobject.h>
-#include <functional>
 #include <iostream>
+#include <memory>
 #include <misc/stringops.h>
-#include <set>
+#include <mutex>
 
 namespace Cel
 {
     namespace
     {
-        struct DecodePal
+        typedef std::vector<Colour>::iterator ColourIterator;
+
+        // Iterator wrappers around the kernels, a zero length run can sit at the very end of a frame,
+        // where the iterator can't be dereferenced.
+        ColourIterator expandPalette(const uint8_t* src, int32_t count, const Pal& pal, ColourIterator dst)
         {
-            DecodePal(const Pal& pal) : mPal(pal) {}
-            Colour operator()(uint8_t code) const { return mPal[code]; }
-            const Pal& mPal;
-        };
+            if (count > 0)
+                Cel::expandPalette(src, count, pal, &*dst);
+            return dst + count;
+        }
+
+        ColourIterator fillTransparent(ColourIterator dst, int32_t count)
+        {
+            if (count > 0)
+                Cel::fillTransparent(&*dst, count);
+            return dst + count;
+        }
     }
 
     Settings::Settings CelDecoder::mSettingsCel;
     Settings::Settings CelDecoder::mSettingsCl2;
 
-    CelDecoder::CelDecoder(const std::string& celPath) : mCelPath(celPath), mAnimationLength(0)
+    CelDecoder::CelDecoder(const std::string& celPath, bool keepIndices) : mCelPath(celPath), mKeepIndices(keepIndices), mAnimationLength(0)
     {
         readCelName();
         readConfiguration();
@@ -30,6 +44,25 @@ namespace Cel
         getFrames();
     }
 
+    CelDecoder::CelDecoder(const std::string& celPath, HeaderOnly) : mCelPath(celPath), mKeepIndices(false), mAnimationLength(0)
+    {
+        readCelName();
+        readConfiguration();
+        getFrames(false);
+    }
+
+    void CelDecoder::getFrameSizes(const std::string& celPath, std::vector<int32_t>& widths, std::vector<int32_t>& heights, int32_t& animLength)
+    {
+        CelDecoder decoder(celPath, HeaderOnly());
+
+        widths.resize(decoder.numFrames());
+        heights.resize(decoder.numFrames());
+        for (int32_t i = 0; i < decoder.numFrames(); i++)
+            decoder.getFrameSize(i, widths[i], heights[i]);
+
+        animLength = decoder.animationLength();
+    }
+
     CelFrame& CelDecoder::operator[](int32_t index)
     {
         auto it = mCache.find(index);
@@ -38,15 +71,14 @@ namespace Cel
             return it->second;
         }
 
-        auto& frame = mFrames[index];
         CelFrame celFrame;
-        decodeFrame(index, frame, celFrame);
+        decodeFrame(index, getFrameBytes(index), celFrame);
 
         mCache[index] = std::move(celFrame);
         return mCache[index];
     }
 
-    int32_t CelDecoder::numFrames() const { return mFrames.size(); }
+    int32_t CelDecoder::numFrames() const { return mNumFrames; }
 
     int32_t CelDecoder::animationLength() const { return mAnimationLength; }
 
@@ -74,14 +106,12 @@ namespace Cel
 
     void CelDecoder::readConfiguration()
     {
-        static bool isConfigurationRead = false;
-
-        if (!isConfigurationRead)
-        {
+        // cels are decoded on the sprite decode threads too
+        static std::once_flag configurationRead;
+        std::call_once(configurationRead, []() {
             mSettingsCel.loadFromFile("resources/cel.ini");
             mSettingsCl2.loadFromFile("resources/cl2.ini");
-            isConfigurationRead = true;
-        }
+        });
 
         Settings::Settings* settings = &mSettingsCel;
         std::string celNameWithoutExtension = mCelName;
@@ -140,82 +170,82 @@ namespace Cel
 
     void CelDecoder::decode()
     {
-        int frameNumber = 0;
-        for (FrameBytesRef frame : mFrames)
+        for (int32_t frameNumber = 0; frameNumber < int32_t(mFrames.size()); frameNumber++)
         {
-
             if (mCache.count(frameNumber))
-            {
-                frameNumber++;
                 continue;
-            }
 
             CelFrame celFrame;
-            decodeFrame(frameNumber, frame, celFrame);
+            decodeFrame(frameNumber, getFrameBytes(frameNumber), celFrame);
             mCache[frameNumber] = std::move(celFrame);
-
-            frameNumber++;
         }
     }
 
-    void CelDecoder::getFrames()
+    void CelDecoder::getFrames(bool readContents)
     {
         // Open CEL file.
 
-        FAIO::FAFileObject file(mCelPath);
-        release_assert(file.isValid());
+        // The whole file is mapped (or read with one call, if it's compressed in the MPQ), and frames are kept as ranges of it.
+        // When only the header is wanted, just the offset tables are read.
+        std::unique_ptr<FAIO::FAFileObject> file;
+        if (readContents)
+        {
+            mFileData = FAIO::mapFile(mCelPath);
+            release_assert(mFileData.isValid());
+        }
+        else
+        {
+            file.reset(new FAIO::FAFileObject(mCelPath));
+            release_assert(file->isValid());
+        }
+
+        auto readWords = [&](size_t offset, uint32_t count, uint32_t* dest) {
+            size_t size = count * sizeof(uint32_t);
+            memset(dest, 0, size);
+
+            if (!readContents)
+            {
+                file->FAfseek(offset, SEEK_SET);
+                file->FAfread(dest, 1, size);
+            }
+            else if (offset < mFileData.size())
+            {
+                memcpy(dest, mFileData.data() + offset, std::min(size, mFileData.size() - offset));
+            }
+        };
 
         // Read first word.
-        uint32_t frameCount = 0;
         uint32_t firstWord = 0;
-        uint32_t repeat = 1;
-        file.FAfread(&firstWord, 4, 1);
+        readWords(0, 1, &firstWord);
 
         std::vector<uint32_t> headerOffsets;
 
         // If firstWord == 32 then it is archive
         // that contains 8 cels and information about offsets in header.
 
-        file.FAfseek(0, SEEK_SET);
-
         if (firstWord == 32)
         {
-            repeat = 8;
-
-            // Read header offsets
-            for (uint32_t i = 0; i < repeat; i++)
-            {
-                uint32_t offset = 0;
-                file.FAfread(&offset, 4, 1);
-                headerOffsets.push_back(offset);
-            }
+            headerOffsets.resize(8);
+            readWords(0, headerOffsets.size(), headerOffsets.data());
         }
 
+        uint32_t repeat = headerOffsets.empty() ? 1 : headerOffsets.size();
+        size_t dataEnd = 0;
+
         for (uint32_t r = 0; r < repeat; r++)
         {
-            // Offset file
-            if (!headerOffsets.empty())
-            {
-                file.FAfseek(headerOffsets[r], SEEK_SET);
-            }
+            size_t base = headerOffsets.empty() ? 0 : headerOffsets[r];
 
-            // Read frame count
-            file.FAfread(&frameCount, 4, 1);
+            // Read frame count and offsets
+            uint32_t frameCount = 0;
+            readWords(base, 1, &frameCount);
 
-            // Read frame offsets.
             std::vector<uint32_t> frameOffsets(frameCount + 1);
-            for (uint32_t i = 0; i < frameCount + 1; i++)
-            {
-                file.FAfread(&frameOffsets[i], 4, 1);
-            }
+            readWords(base + 4, frameCount + 1, frameOffsets.data());
 
-            // Magic offset that fixes everything!
-            if (!headerOffsets.empty())
-            {
-                file.FAfseek(headerOffsets[r] + frameOffsets[0], SEEK_SET);
-            }
+            // Magic offset that fixes everything! Plain cels just have their frames straight after the offsets.
+            size_t dataStart = headerOffsets.empty() ? base + 4 * (frameCount + 2) : base + frameOffsets[0];
 
-            // Read frame contents
             for (uint32_t i = 0; i < frameCount; i++)
             {
                 int64_t frameStart = int64_t(frameOffsets[i]) + mHeaderSize;
@@ -227,106 +257,150 @@ namespace Cel
                     return;
                 }
 
-                mFrames.push_back(std::vector<uint8_t>(static_cast<int32_t>(frameSize)));
-                uint32_t idx = mFrames.size() - 1;
-                file.FAfseek(mHeaderSize, SEEK_CUR);
-                file.FAfread(&mFrames[idx][0], 1, static_cast<int32_t>(frameSize));
+                mNumFrames++;
+                if (!readContents)
+                    continue;
+
+                size_t offset = dataStart + size_t(frameStart - frameOffsets[0]);
+                mFrames.push_back(FrameSpan{offset, size_t(frameSize)});
+                dataEnd = std::max(dataEnd, offset + size_t(frameSize));
             }
 
             mAnimationLength = frameCount;
         }
-    }
 
-    void CelDecoder::decodeFrame(int32_t index, FrameBytesRef frame, CelFrame& celFrame)
-    {
-        auto decoder = getFrameDecoder(mCelName, frame, index);
-
-        if (mIsObjcursCel)
-        {
-            setObjcursCelDimensions(index);
-        }
-        else if (mIsCharbutCel)
+        // Frames that run off the end of a truncated file read as zeros
+        if (dataEnd > mFileData.size())
         {
-            setCharbutCelDimensions(index);
+            std::vector<uint8_t> padded(mFileData.data(), mFileData.data() + mFileData.size());
+            padded.resize(dataEnd, 0);
+            mFileData = FAIO::FileSpan(std::move(padded));
         }
 
-        celFrame = CelFrame(mFrameWidth, mFrameHeight);
-        decoder(*this, frame, mPal, celFrame);
-        // assert (it == celFrame.mRawImage.end ());
+        if (readContents)
+            classifyFrames();
+    }
+
+    CelDecoder::FrameBytes CelDecoder::getFrameBytes(int32_t index) const
+    {
+        const FrameSpan& span = mFrames[index];
+        return FrameBytes{mFileData.data() + span.offset, span.size};
     }
 
-    CelDecoder::FrameDecoder CelDecoder::getFrameDecoder(const std::string& celName, FrameBytesRef frame, int frameNumber)
+    void CelDecoder::getFrameSize(int32_t index, int32_t& width, int32_t& height) const
     {
-        static std::set<std::string> filenames = {"l1.cel", "l2.cel", "l3.cel", "l4.cel", "town.cel"};
-        int frameSize = frame.size();
-        bool isInFilenames = filenames.find(celName) != filenames.end();
+        width = mFrameWidth;
+        height = mFrameHeight;
 
-        if (isInFilenames)
+        if (mIsObjcursCel)
         {
-            switch (frameSize)
-            {
-                case 0x400:
-                    if (isType0(celName, frameNumber))
-                        return &CelDecoder::decodeFrameType0;
-                    break;
-                case 0x220:
-                    if (isType2or4(frame))
-                        return &CelDecoder::decodeFrameType2;
-                    else if (isType3or5(frame))
-                        return &CelDecoder::decodeFrameType3;
-                    break;
-                case 0x320:
-                    if (isType2or4(frame))
-                        return &CelDecoder::decodeFrameType4;
-                    else if (isType3or5(frame))
-                        return &CelDecoder::decodeFrameType5;
-                    break;
-            }
+            getObjcursCelDimensions(index, width, height);
         }
-        else if (Misc::StringUtils::endsWith(celName, "cl2"))
+        else if (mIsCharbutCel)
         {
-            return &CelDecoder::decodeFrameType6;
+            width = getCharbutCelWidth(index);
         }
-
-        return &CelDecoder::decodeFrameType1;
     }
 
-    // isType0 returns true if the image is a plain 32x32.
-    bool CelDecoder::isType0(const std::string& celName, int frameNumber)
+    CelFrame CelDecoder::decodeFrame(int32_t index) const
     {
-        std::set<int> numbers;
+        CelFrame celFrame;
+        decodeFrame(index, getFrameBytes(index), celFrame);
+        return celFrame;
+    }
 
-        if (celName == "l1.cel")
-        {
-            numbers = {148, 159, 181, 186, 188};
-        }
-        else if (celName == "l2.cel")
-        {
-            numbers = {47, 1397, 1399, 1411};
-        }
-        else if (celName == "l4.cel")
-        {
-            numbers = {336, 639};
-        }
-        else if (celName == "town.cel")
-        {
-            numbers = {2328, 2367, 2593};
+    void CelDecoder::decodeFrame(int32_t index, FrameBytesRef frame, CelFrame& celFrame) const
+    {
+        int32_t width, height;
+        getFrameSize(index, width, height);
+
+        celFrame = CelFrame(width, height);
+        const Pal& pal = mKeepIndices ? Pal::indices() : mPal;
+
+        switch (mFrameTypes[index])
+        {
+            case FrameType::Type0:
+                decodeFrameType0(frame, pal, celFrame);
+                break;
+            case FrameType::Type1:
+                decodeFrameType1(frame, pal, celFrame);
+                break;
+            case FrameType::Type2:
+                decodeFrameType2(frame, pal, celFrame);
+                break;
+            case FrameType::Type3:
+                decodeFrameType3(frame, pal, celFrame);
+                break;
+            case FrameType::Type4:
+                decodeFrameType4(frame, pal, celFrame);
+                break;
+            case FrameType::Type5:
+                decodeFrameType5(frame, pal, celFrame);
+                break;
+            case FrameType::Type6:
+                decodeFrameType6(frame, pal, celFrame);
+                break;
         }
+    }
 
-        if (numbers.find(frameNumber) != numbers.end())
-        {
-            return false;
-        }
+    // classifyFrames works out every frame's type once, when the file is opened, so decoding a frame
+    // is just a switch on its type.
+    void CelDecoder::classifyFrames()
+    {
+        // Only the level tilesets have frames of types 0 and 2-5, every frame of anything else has the same type
+        bool isTileset = mCelName == "l1.cel" || mCelName == "l2.cel" || mCelName == "l3.cel" || mCelName == "l4.cel" || mCelName == "town.cel";
+
+        FrameType fileType = mIsCl2 ? FrameType::Type6 : FrameType::Type1;
+        mFrameTypes.assign(mFrames.size(), fileType);
+
+        if (!isTileset)
+            return;
+
+        // Frames of the size of a plain 32x32 image that aren't one
+        std::vector<int32_t> notType0;
+        if (mCelName == "l1.cel")
+            notType0 = {148, 159, 181, 186, 188};
+        else if (mCelName == "l2.cel")
+            notType0 = {47, 1397, 1399, 1411};
+        else if (mCelName == "l4.cel")
+            notType0 = {336, 639};
+        else if (mCelName == "town.cel")
+            notType0 = {2328, 2367, 2593};
+
+        for (size_t i = 0; i < mFrames.size(); i++)
+            mFrameTypes[i] = getFrameType(getFrameBytes(i), i, notType0);
+    }
 
-        return true;
+    CelDecoder::FrameType CelDecoder::getFrameType(FrameBytesRef frame, int frameNumber, const std::vector<int32_t>& notType0) const
+    {
+        switch (frame.size())
+        {
+            case 0x400:
+                if (std::find(notType0.begin(), notType0.end(), frameNumber) == notType0.end())
+                    return FrameType::Type0;
+                break;
+            case 0x220:
+                if (isType2or4(frame))
+                    return FrameType::Type2;
+                else if (isType3or5(frame))
+                    return FrameType::Type3;
+                break;
+            case 0x320:
+                if (isType2or4(frame))
+                    return FrameType::Type4;
+                else if (isType3or5(frame))
+                    return FrameType::Type5;
+                break;
+        }
+
+        return FrameType::Type1;
     }
 
     // isType2or4 returns true if the image is a triangle or a trapezoid pointing to
     // the left.
     bool CelDecoder::isType2or4(FrameBytesRef frame)
     {
-
-        std::vector<int> zeroPositions = {0, 1, 8, 9, 24, 25, 48, 49, 80, 81, 120, 121, 168, 169, 224, 225};
+        static const int zeroPositions[] = {0, 1, 8, 9, 24, 25, 48, 49, 80, 81, 120, 121, 168, 169, 224, 225};
         for (int i : zeroPositions)
         {
             if (frame[i] != 0)
@@ -342,8 +416,7 @@ namespace Cel
     // the right.
     bool CelDecoder::isType3or5(FrameBytesRef frame)
     {
-
-        std::vector<int> zeroPositions = {2, 3, 14, 15, 34, 35, 62, 63, 98, 99, 142, 143, 194, 195, 254, 255};
+        static const int zeroPositions[] = {2, 3, 14, 15, 34, 35, 62, 63, 98, 99, 142, 143, 194, 195, 254, 255};
         for (int i : zeroPositions)
         {
             if (frame[i] != 0)
@@ -365,9 +438,9 @@ namespace Cel
     //
     // Type0 corresponds to a plain 32x32 images, with no transparency.
     //
-    void CelDecoder::decodeFrameType0(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame)
+    void CelDecoder::decodeFrameType0(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame) const
     {
-        std::transform(frame.begin(), frame.end(), decodedFrame.begin(), DecodePal{pal});
+        expandPalette(frame.data(), frame.size(), pal, decodedFrame.begin());
     }
 
     // DecodeFrameType1 returns an image after decoding the frame in the following
@@ -383,7 +456,7 @@ namespace Cel
     //
     // Type1 corresponds to a regular CEL frame image of the specified dimensions.
     //
-    void CelDecoder::decodeFrameType1(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame)
+    void CelDecoder::decodeFrameType1(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame) const
     {
         auto frameIterator = decodedFrame.begin();
 
@@ -395,12 +468,12 @@ namespace Cel
             if (chunkSize < 0)
             {
                 // Transparent pixels.
-                frameIterator = std::fill_n(frameIterator, -chunkSize, Cel::Colour{0, 0, 0, false});
+                frameIterator = fillTransparent(frameIterator, -chunkSize);
             }
             else
             {
                 // Regular pixels.
-                frameIterator = std::transform(frame.begin() + pos, frame.begin() + pos + chunkSize, frameIterator, DecodePal{pal});
+                frameIterator = expandPalette(frame.data() + pos, chunkSize, pal, frameIterator);
                 pos += chunkSize;
             }
         }
@@ -456,7 +529,10 @@ namespace Cel
     //
     // Type2 corresponds to a 32x32 images of a left facing triangle.
     //
-    void CelDecoder::decodeFrameType2(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame) { decodeFrameType2or3(frame, pal, decodedFrame, true); }
+    void CelDecoder::decodeFrameType2(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame) const
+    {
+        decodeFrameType2or3(frame, pal, decodedFrame, true);
+    }
 
     // DecodeFrameType3 returns an image after decoding the frame in the following
     // way:
@@ -508,7 +584,10 @@ namespace Cel
     //    +--------------------------------+
     //
     // Type3 corresponds to a 32x32 images of a right facing triangle.
-    void CelDecoder::decodeFrameType3(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame) { decodeFrameType2or3(frame, pal, decodedFrame, false); }
+    void CelDecoder::decodeFrameType3(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame) const
+    {
+        decodeFrameType2or3(frame, pal, decodedFrame, false);
+    }
 
     // DecodeFrameType4 returns an image after decoding the frame in the following
     // way:
@@ -560,7 +639,10 @@ namespace Cel
     //    +--------------------------------+
     //
     // Type4 corresponds to a 32x32 images of a left facing trapezoid.
-    void CelDecoder::decodeFrameType4(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame) { decodeFrameType4or5(frame, pal, decodedFrame, true); }
+    void CelDecoder::decodeFrameType4(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame) const
+    {
+        decodeFrameType4or5(frame, pal, decodedFrame, true);
+    }
 
     // DecodeFrameType5 returns an image after decoding the frame in the following
     // way:
@@ -612,7 +694,10 @@ namespace Cel
     //    +--------------------------------+
     //
     // Type5 corresponds to a 32x32 images of a right facing trapezoid.
-    void CelDecoder::decodeFrameType5(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame) { decodeFrameType4or5(frame, pal, decodedFrame, false); }
+    void CelDecoder::decodeFrameType5(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame) const
+    {
+        decodeFrameType4or5(frame, pal, decodedFrame, false);
+    }
 
     // DecodeFrameType6 returns an image after decoding the frame in the following
     // way:
@@ -633,15 +718,17 @@ namespace Cel
     //    4) goto 1 until EOF is reached.
     //
     // Type6 is the only type for CL2 images.
-    void CelDecoder::decodeFrameType6(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame)
+    void CelDecoder::decodeFrameType6(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame) const
     {
         int32_t frameIndex = 0;
+        int32_t frameEnd = decodedFrame.width() * decodedFrame.height();
+        Colour* pixels = decodedFrame.getFlatVector().data();
 
         int32_t len = frame.size();
         for (int32_t pos = 0; pos < len;)
         {
             // Some broken cl2s (afaik only firema.cl2) seem to have some rubbish tacked on the end of their frames
-            if (frameIndex == decodedFrame.width() * decodedFrame.height())
+            if (frameIndex == frameEnd)
                 return;
 
             int32_t chunkSize = int32_t(int8_t(frame[pos]));
@@ -649,11 +736,9 @@ namespace Cel
             if (chunkSize >= 0)
             {
                 // Transparent pixels.
-                for (int32_t i = 0; i < chunkSize; i++)
-                {
-                    debug_assert(decodedFrame.getFlatVector().size() > size_t(frameIndex));
-                    decodedFrame.getFlatVector()[frameIndex++] = Cel::Colour{0, 0, 0, false};
-                }
+                debug_assert(frameIndex + chunkSize <= frameEnd);
+                fillTransparent(pixels + frameIndex, chunkSize);
+                frameIndex += chunkSize;
             }
             else
             {
@@ -661,32 +746,27 @@ namespace Cel
                 if (chunkSize <= 65)
                 {
                     // Regular pixels.
-                    for (int32_t i = pos; i < pos + chunkSize; i++)
-                    {
-                        debug_assert(decodedFrame.getFlatVector().size() > size_t(frameIndex));
-                        decodedFrame.getFlatVector()[frameIndex++] = pal[frame[i]];
-                    }
+                    debug_assert(frameIndex + chunkSize <= frameEnd);
+                    expandPalette(frame.data() + pos, chunkSize, pal, pixels + frameIndex);
+                    frameIndex += chunkSize;
 
                     pos += chunkSize;
                 }
                 else
                 {
                     chunkSize -= 65;
-                    Colour c = pal[frame[pos]];
 
                     // Run-length encoded pixels.
-                    for (int32_t i = 0; i < chunkSize; i++)
-                    {
-                        debug_assert(decodedFrame.getFlatVector().size() > size_t(frameIndex));
-                        decodedFrame.getFlatVector()[frameIndex++] = c;
-                    }
+                    debug_assert(frameIndex + chunkSize <= frameEnd);
+                    fillColour(pixels + frameIndex, chunkSize, pal[frame[pos]]);
+                    frameIndex += chunkSize;
                     pos++;
                 }
             }
         }
     }
 
-    void CelDecoder::decodeFrameType2or3(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame, bool frameType2)
+    void CelDecoder::decodeFrameType2or3(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame, bool frameType2) const
     {
         auto frameIterator = decodedFrame.begin();
 
@@ -737,7 +817,7 @@ namespace Cel
         }
     }
 
-    void CelDecoder::decodeFrameType4or5(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame, bool frameType4)
+    void CelDecoder::decodeFrameType4or5(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame, bool frameType4) const
     {
         auto frameIterator = decodedFrame.begin();
 
@@ -778,110 +858,100 @@ namespace Cel
 
         if (frame.size() > 256)
         {
-            frameIterator = std::transform(frame.begin() + 256, frame.end(), frameIterator, DecodePal{pal});
+            frameIterator = expandPalette(frame.data() + 256, frame.size() - 256, pal, frameIterator);
         }
     }
 
-    void CelDecoder::decodeLineTransparencyLeft(const uint8_t** framePtr, const Pal& pal, ColoursRefIterator& decodedFrame, int regularCount)
+    void CelDecoder::decodeLineTransparencyLeft(const uint8_t** framePtr, const Pal& pal, ColoursRefIterator& decodedFrame, int regularCount) const
     {
         int transparentCount = 32 - regularCount;
 
         // Implicit transparent pixels.
-        decodedFrame = std::fill_n(decodedFrame, transparentCount, Cel::Colour{0, 0, 0, false});
+        decodedFrame = fillTransparent(decodedFrame, transparentCount);
 
         // Explicit regular pixels.
-        for (int i = 0; i < regularCount; i++)
-        {
-            Colour color = pal[(*framePtr)[0]];
-            *decodedFrame = color;
-            ++decodedFrame;
-            (*framePtr)++;
-        }
+        decodedFrame = expandPalette(*framePtr, regularCount, pal, decodedFrame);
+        *framePtr += regularCount;
     }
 
-    void CelDecoder::decodeLineTransparencyRight(const uint8_t** framePtr, const Pal& pal, ColoursRefIterator& decodedFrame, int regularCount)
+    void CelDecoder::decodeLineTransparencyRight(const uint8_t** framePtr, const Pal& pal, ColoursRefIterator& decodedFrame, int regularCount) const
     {
         int transparentCount = 32 - regularCount;
 
         // Explicit regular pixels.
-        for (int i = 0; i < regularCount; i++)
-        {
-            Colour color = pal[(*framePtr)[0]];
-            *decodedFrame = color;
-            ++decodedFrame;
-            (*framePtr)++;
-        }
+        decodedFrame = expandPalette(*framePtr, regularCount, pal, decodedFrame);
+        *framePtr += regularCount;
 
         // Transparent pixels.
 
-        decodedFrame = std::fill_n(decodedFrame, transparentCount, Cel::Colour{0, 0, 0, false});
+        decodedFrame = fillTransparent(decodedFrame, transparentCount);
     }
 
-    void CelDecoder::setObjcursCelDimensions(int frameNumber)
+    void CelDecoder::getObjcursCelDimensions(int frameNumber, int32_t& width, int32_t& height) const
     {
-        mFrameWidth = 56;
-        mFrameHeight = 84;
+        width = 56;
+        height = 84;
 
         // Width
         if (frameNumber == 0)
         {
-            mFrameWidth = 33;
+            width = 33;
         }
         else if (frameNumber > 0 && frameNumber < 10)
         {
-            mFrameWidth = 32;
+            width = 32;
         }
         else if (frameNumber == 10)
         {
-            mFrameWidth = 23;
+            width = 23;
         }
         else if (frameNumber > 10 && frameNumber < 86)
         {
-            mFrameWidth = 28;
+            width = 28;
         }
         else if (frameNumber >= 86 && frameNumber < 111)
         {
-            mFrameWidth = 56;
+            width = 56;
         }
 
         // Height
         if (frameNumber == 0)
         {
-            mFrameHeight = 29;
+            height = 29;
         }
         else if (frameNumber > 0 && frameNumber < 10)
         {
-            mFrameHeight = 32;
+            height = 32;
         }
         else if (frameNumber == 10)
         {
-            mFrameHeight = 35;
+            height = 35;
         }
         else if (frameNumber >= 11 && frameNumber < 61)
         {
-            mFrameHeight = 28;
+            height = 28;
         }
         else if (frameNumber >= 61 && frameNumber < 67)
         {
-            mFrameHeight = 56;
+            height = 56;
         }
         else if (frameNumber >= 67 && frameNumber < 86)
         {
-            mFrameHeight = 84;
+            height = 84;
         }
         else if (frameNumber >= 86 && frameNumber < 111)
         {
-            mFrameHeight = 56;
+            height = 56;
         }
     }
 
-    void CelDecoder::setCharbutCelDimensions(int frameNumber)
+    int32_t CelDecoder::getCharbutCelWidth(int frameNumber) const
     {
-        mFrameWidth = 41;
-
         if (frameNumber == 0)
         {
-            mFrameWidth = 95;
+            return 95;
         }
+
+        return 41;
     }
 }
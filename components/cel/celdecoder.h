@@ -3,7 +3,7 @@
 
 #include "celframe.h"
 #include "pal.h"
-#include <functional>
+#include <faio/faio.h>
 #include <map>
 #include <settings/settings.h>
 #include <stdint.h>
@@ -15,51 +15,97 @@ namespace Cel
     class CelDecoder
     {
     public:
-        CelDecoder(const std::string& celPath);
+        /// @param keepIndices decode to palette indices (see Pal::indices) instead of colours
+        CelDecoder(const std::string& celPath, bool keepIndices = false);
         void decode();
         CelFrame& operator[](int32_t index);
+        /// Decodes a frame without caching it. Unlike operator[] this doesn't change the decoder at all,
+        /// so it can be called from several threads at once.
+        CelFrame decodeFrame(int32_t index) const;
         int32_t numFrames() const;
         int32_t animationLength() const;
+        const Pal& palette() const { return mPal; }
+
+        /// Frame sizes come from the cel configs rather than the frame data, so this only reads the frame counts
+        /// from the file header, without reading or decoding any frames.
+        static void getFrameSizes(const std::string& celPath, std::vector<int32_t>& widths, std::vector<int32_t>& heights, int32_t& animLength);
 
     private:
-        typedef std::vector<uint8_t> FrameBytes;
-        typedef const std::vector<uint8_t>& FrameBytesRef;
+        struct HeaderOnly
+        {
+        };
+        CelDecoder(const std::string& celPath, HeaderOnly);
+
+        /// One frame's encoded bytes, a range of mFileData
+        struct FrameBytes
+        {
+            const uint8_t* ptr;
+            size_t length;
+
+            const uint8_t* data() const { return ptr; }
+            size_t size() const { return length; }
+            const uint8_t& operator[](size_t index) const { return ptr[index]; }
+        };
+        typedef const FrameBytes& FrameBytesRef;
         typedef std::vector<Colour>& ColoursRef;
         typedef std::vector<Colour>::iterator ColoursRefIterator;
-        typedef std::function<void(CelDecoder&, FrameBytesRef, const Pal&, CelFrame&)> FrameDecoder;
+
+        /// Which of the decodeFrameType* functions a frame needs
+        enum class FrameType : uint8_t
+        {
+            Type0,
+            Type1,
+            Type2,
+            Type3,
+            Type4,
+            Type5,
+            Type6
+        };
 
         void readConfiguration();
         void readCelName();
         void readPalette();
 
-        void getFrames();
-        void decodeFrame(int32_t index, FrameBytesRef frame, CelFrame& celFrame);
-        FrameDecoder getFrameDecoder(const std::string& celName, FrameBytesRef frame, int frameNumber);
-        bool isType0(const std::string& celName, int frameNumber);
-        bool isType2or4(FrameBytesRef frame);
-        bool isType3or5(FrameBytesRef frame);
+        void getFrames(bool readContents = true);
+        FrameBytes getFrameBytes(int32_t index) const;
+        void getFrameSize(int32_t index, int32_t& width, int32_t& height) const;
+        void decodeFrame(int32_t index, FrameBytesRef frame, CelFrame& celFrame) const;
+        void classifyFrames();
+        FrameType getFrameType(FrameBytesRef frame, int frameNumber, const std::vector<int32_t>& notType0) const;
+        static bool isType2or4(FrameBytesRef frame);
+        static bool isType3or5(FrameBytesRef frame);
+
+        void decodeFrameType0(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame) const;
+        void decodeFrameType1(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame) const;
+        void decodeFrameType2(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame) const;
+        void decodeFrameType3(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame) const;
+        void decodeFrameType4(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame) const;
+        void decodeFrameType5(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame) const;
+        void decodeFrameType6(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame) const;
+        void decodeFrameType2or3(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame, bool frameType2) const;
+        void decodeFrameType4or5(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame, bool frameType4) const;
 
-        void decodeFrameType0(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame);
-        void decodeFrameType1(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame);
-        void decodeFrameType2(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame);
-        void decodeFrameType3(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame);
-        void decodeFrameType4(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame);
-        void decodeFrameType5(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame);
-        void decodeFrameType6(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame);
-        void decodeFrameType2or3(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame, bool frameType2);
-        void decodeFrameType4or5(FrameBytesRef frame, const Pal& pal, CelFrame& decodedFrame, bool frameType4);
+        void decodeLineTransparencyLeft(const uint8_t** framePtr, const Pal& pal, ColoursRefIterator& decodedFrame, int) const;
+        void decodeLineTransparencyRight(const uint8_t** framePtr, const Pal& pal, ColoursRefIterator& decodedFrame, int) const;
+        void getObjcursCelDimensions(int frame, int32_t& width, int32_t& height) const;
+        int32_t getCharbutCelWidth(int frame) const;
 
-        void decodeLineTransparencyLeft(const uint8_t** framePtr, const Pal& pal, ColoursRefIterator& decodedFrame, int);
-        void decodeLineTransparencyRight(const uint8_t** framePtr, const Pal& pal, ColoursRefIterator& decodedFrame, int);
-        void setObjcursCelDimensions(int frame);
-        void setCharbutCelDimensions(int frame);
+        struct FrameSpan
+        {
+            size_t offset;
+            size_t size;
+        };
 
-        std::vector<FrameBytes> mFrames;
+        FAIO::FileSpan mFileData;       ///< The whole file, left empty by the HeaderOnly constructor
+        std::vector<FrameSpan> mFrames; ///< Where each frame is in mFileData
+        std::vector<FrameType> mFrameTypes;
+        int32_t mNumFrames = 0;
         std::map<int32_t, CelFrame> mCache;
         std::string mCelPath;
         std::string mCelName;
         Pal mPal;
-        bool mIsCl2;
+        bool mKeepIndices;
+        bool mIsCl2 = false;
         bool mIsObjcursCel;
         bool mIsCharbutCel;
         int mImageCount;
@@ -4,7 +4,7 @@
 
 namespace Cel
 {
-    CelFile::CelFile(const std::string& filename) : mDecoder(filename) {}
+    CelFile::CelFile(const std::string& filename, bool keepIndices) : mDecoder(filename, keepIndices) {}
 
     int32_t CelFile::numFrames() const { return mDecoder.numFrames(); }
 
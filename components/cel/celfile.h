@@ -15,12 +15,15 @@ namespace Cel
     class CelFile
     {
     public:
-        CelFile(const std::string& filename);
+        /// @param keepIndices decode frames to palette indices in the red channel, rather than colours
+        CelFile(const std::string& filename, bool keepIndices = false);
 
         // If normal cel file, returns same as numFrames(), for an archive, the number of frames in each subcel
         int32_t animLength() const;
         int32_t numFrames() const;
         CelFrame& operator[](int32_t index);
+        CelFrame decodeFrame(int32_t index) const { return mDecoder.decodeFrame(index); } ///< Uncached, so safe to call from several threads at once
+        const Pal& palette() const { return mDecoder.palette(); }
 
     private:
         CelDecoder mDecoder;
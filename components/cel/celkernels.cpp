@@ -0,0 +1,135 @@
+#include "celkernels.h"
+#include <cstring>
+
+#if !defined(FA_CEL_NO_SIMD) && defined(__AVX2__)
+#define FA_CEL_USE_AVX2
+#include <immintrin.h>
+#elif !defined(FA_CEL_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define FA_CEL_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Cel
+{
+    static_assert(sizeof(Colour) == 4, "the kernels treat a Colour as one 32 bit word");
+
+    namespace
+    {
+        // Pal::indices() maps n to Colour(n, 0, 0, true), so expanding through it is just zero extending to 32 bits,
+        // which doesn't need a table lookup at all. This is the common case, as sprites are stored as indices.
+        constexpr uint32_t INDEX_VISIBLE_BIT = uint32_t(1) << 24;
+
+        void expandPaletteScalar(const uint8_t* src, int32_t count, const Colour* pal, Colour* dst)
+        {
+            for (int32_t i = 0; i < count; i++)
+                dst[i] = pal[src[i]];
+        }
+
+        void fillColourScalar(Colour* dst, int32_t count, Colour colour)
+        {
+            for (int32_t i = 0; i < count; i++)
+                dst[i] = colour;
+        }
+
+#if defined(FA_CEL_USE_AVX2) || defined(FA_CEL_USE_SSE2)
+        uint32_t toWord(Colour colour)
+        {
+            uint32_t word;
+            memcpy(&word, &colour, sizeof(word));
+            return word;
+        }
+#endif
+    }
+
+#if defined(FA_CEL_USE_AVX2)
+
+    void expandPalette(const uint8_t* src, int32_t count, const Pal& pal, Colour* dst)
+    {
+        int32_t i = 0;
+
+        if (&pal == &Pal::indices())
+        {
+            const __m256i visible = _mm256_set1_epi32(INDEX_VISIBLE_BIT);
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256i indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_or_si256(indices, visible));
+            }
+        }
+        else
+        {
+            const int* table = reinterpret_cast<const int*>(pal.data());
+            for (; i + 8 <= count; i += 8)
+            {
+                __m256i indices = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_i32gather_epi32(table, indices, 4));
+            }
+        }
+
+        expandPaletteScalar(src + i, count - i, pal.data(), dst + i);
+    }
+
+    void fillColour(Colour* dst, int32_t count, Colour colour)
+    {
+        int32_t i = 0;
+
+        const __m256i value = _mm256_set1_epi32(int(toWord(colour)));
+        for (; i + 8 <= count; i += 8)
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), value);
+
+        fillColourScalar(dst + i, count - i, colour);
+    }
+
+    const char* kernelsName() { return "avx2"; }
+
+#elif defined(FA_CEL_USE_SSE2)
+
+    void expandPalette(const uint8_t* src, int32_t count, const Pal& pal, Colour* dst)
+    {
+        int32_t i = 0;
+
+        // SSE2 has no gather, so only the index palette gets a vector path
+        if (&pal == &Pal::indices())
+        {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i visible = _mm_set1_epi32(INDEX_VISIBLE_BIT);
+            for (; i + 16 <= count; i += 16)
+            {
+                __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+                __m128i low = _mm_unpacklo_epi8(bytes, zero);
+                __m128i high = _mm_unpackhi_epi8(bytes, zero);
+
+                __m128i* out = reinterpret_cast<__m128i*>(dst + i);
+                _mm_storeu_si128(out + 0, _mm_or_si128(_mm_unpacklo_epi16(low, zero), visible));
+                _mm_storeu_si128(out + 1, _mm_or_si128(_mm_unpackhi_epi16(low, zero), visible));
+                _mm_storeu_si128(out + 2, _mm_or_si128(_mm_unpacklo_epi16(high, zero), visible));
+                _mm_storeu_si128(out + 3, _mm_or_si128(_mm_unpackhi_epi16(high, zero), visible));
+            }
+        }
+
+        expandPaletteScalar(src + i, count - i, pal.data(), dst + i);
+    }
+
+    void fillColour(Colour* dst, int32_t count, Colour colour)
+    {
+        int32_t i = 0;
+
+        const __m128i value = _mm_set1_epi32(int(toWord(colour)));
+        for (; i + 4 <= count; i += 4)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), value);
+
+        fillColourScalar(dst + i, count - i, colour);
+    }
+
+    const char* kernelsName() { return "sse2"; }
+
+#else
+
+    void expandPalette(const uint8_t* src, int32_t count, const Pal& pal, Colour* dst) { expandPaletteScalar(src, count, pal.data(), dst); }
+
+    void fillColour(Colour* dst, int32_t count, Colour colour) { fillColourScalar(dst, count, colour); }
+
+    const char* kernelsName() { return "scalar"; }
+
+#endif
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "pal.h"
+#include <stdint.h>
+
+// The inner loops of the cel decoders, these are where nearly all of the decode time goes.
+// They use SSE2, and AVX2 if the Cel library was built with it (FA_CEL_AVX2 in cmake), falling back to
+// plain loops elsewhere or when FA_CEL_SIMD is turned off.
+
+namespace Cel
+{
+    /// dst[i] = pal[src[i]] for count pixels
+    void expandPalette(const uint8_t* src, int32_t count, const Pal& pal, Colour* dst);
+
+    /// Sets count pixels to colour
+    void fillColour(Colour* dst, int32_t count, Colour colour);
+
+    inline void fillTransparent(Colour* dst, int32_t count) { fillColour(dst, count, Colour(0, 0, 0, false)); }
+
+    /// "avx2", "sse2" or "scalar", for logging and benchmarks
+    const char* kernelsName();
+}
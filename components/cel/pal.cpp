@@ -19,4 +19,16 @@ namespace Cel
     }
 
     const Colour& Pal::operator[](size_t index) const { return contents.data()[index]; }
+
+    const Pal& Pal::indices()
+    {
+        static const Pal indexPal = []() {
+            Pal pal;
+            for (int i = 0; i < 256; i++)
+                pal.contents[i] = Colour(i, 0, 0, true);
+            return pal;
+        }();
+
+        return indexPal;
+    }
 }
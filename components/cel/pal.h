@@ -31,6 +31,11 @@ namespace Cel
         Pal(const std::string& filename);
 
         const Colour& operator[](size_t index) const;
+        Colour& operator[](size_t index) { return contents[index]; }
+        const Colour* data() const { return contents.data(); } ///< all 256 entries
+
+        /// Maps every index n to Colour(n, 0, 0), so frames decoded with it keep their raw palette indices in the red channel
+        static const Pal& indices();
 
     private:
         std::vector<Colour> contents;
@@ -11,7 +11,7 @@ namespace FAIO
     {
 
     public:
-        FAFileObject(const std::string pathFile);
+        FAFileObject(const std::string& pathFile);
         FAFileObject(const FAFileObject&) = delete;
         ~FAFileObject();
 
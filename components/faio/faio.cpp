@@ -1,13 +1,22 @@
 #include "faio.h"
+#include "pack.h"
 
+#include <algorithm>
+#include <atomic>
 #include <boost/algorithm/string.hpp>
 #include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <cstring>
+#include <deque>
 #include <iostream>
 #include <misc/assert.h>
 #include <misc/stringops.h>
 #include <mutex>
+#include <unordered_map>
 
 namespace bfs = boost::filesystem;
+namespace bip = boost::interprocess;
 
 // clang-format off
 #include <misc/disablewarn.h>
@@ -20,7 +29,6 @@ namespace FAIO
     FAFile::FAFile() {}
 
     const std::string DIABDAT_MPQ = "DIABDAT.MPQ";
-    std::mutex m;
 
     // StormLib needs paths with windows style \'s
     std::string getStormLibPath(const bfs::path& path)
@@ -37,25 +45,274 @@ namespace FAIO
         return retval;
     }
 
-    HANDLE diabdat = NULL;
+    // A StormLib archive handle has a single file position and caches shared by everything opened through it, so it can't be
+    // used from two threads at once. Rather than lock around every call, each thread opens the archive for itself the first
+    // time it needs it. Opening only reads the hash and block tables, so it's cheap, and after that no MPQ access ever waits
+    // on another thread. init() and quit() bump the generation, which makes every thread drop its handle and open a new one.
+    std::mutex archivesMutex; ///< Guards the members below, only taken when a thread opens or closes its handle
+    std::string archivePath;
+    std::string archiveListFile;
+    std::vector<HANDLE> openArchives;
+    std::atomic<uint32_t> archiveGeneration(1);
+
+    // The whole MPQ mapped read only, for mapFile() to serve uncompressed entries from. Never written to while mapped,
+    // so the threads can all read it with no locking.
+    std::shared_ptr<const bip::mapped_region> archiveMapping;
+    uint64_t archiveHeaderOffset = 0;
+
+    // Only changed by mountPack() and quit(), which aren't called while anything else is reading
+    std::unique_ptr<const Pack> mountedPack;
+
+    std::shared_ptr<const bip::mapped_region> mapWholeFile(const std::string& path)
+    {
+        try
+        {
+            bip::file_mapping mapping(path.c_str(), bip::read_only);
+            return std::make_shared<const bip::mapped_region>(mapping, bip::read_only);
+        }
+        catch (const bip::interprocess_exception&)
+        {
+            // eg. an empty file, which can't be mapped
+            return nullptr;
+        }
+    }
+
+    struct ThreadArchive
+    {
+        HANDLE handle = NULL;
+        uint32_t generation = 0;
+
+        ~ThreadArchive() { close(); }
+
+        void close()
+        {
+            std::lock_guard<std::mutex> lock(archivesMutex);
+
+            // if the generation has moved on, quit() has already closed it
+            if (handle != NULL && generation == archiveGeneration)
+            {
+                openArchives.erase(std::find(openArchives.begin(), openArchives.end(), handle));
+                SFileCloseArchive(handle);
+            }
+
+            handle = NULL;
+        }
+    };
+
+    thread_local ThreadArchive threadArchive;
+
+    /// The calling thread's handle to the MPQ, or NULL if there isn't one open
+    HANDLE getArchive()
+    {
+        if (threadArchive.generation == archiveGeneration)
+            return threadArchive.handle;
+
+        threadArchive.close();
+
+        std::lock_guard<std::mutex> lock(archivesMutex);
+        threadArchive.generation = archiveGeneration;
+
+        if (archivePath.empty())
+            return NULL;
+
+        if (!SFileOpenArchive(archivePath.c_str(), 0, STREAM_FLAG_READ_ONLY, &threadArchive.handle))
+        {
+            std::cerr << "Failed to open " << archivePath << " with error " << GetLastError() << std::endl;
+            threadArchive.handle = NULL;
+            return NULL;
+        }
+
+        if (!archiveListFile.empty())
+            SFileAddListFile(threadArchive.handle, archiveListFile.c_str());
+
+        openArchives.push_back(threadArchive.handle);
+        return threadArchive.handle;
+    }
+
+    // Where each path that's been asked for was found, so that looking one up again is a single hash probe, rather than a
+    // stat of the filesystem, a rebuild of the path with \'s for StormLib, and a search of the pack and the MPQ.
+    // Keys are case insensitive and treat / and \ the same, as the MPQ does. Like the archive handles, each thread keeps
+    // its own index so lookups never take a lock, and init(), quit() and mountPack() bump the generation to throw them out.
+    // It follows that files added to the disk later aren't seen until one of those is called.
+    enum class PathLocation : uint8_t
+    {
+        Missing,
+        Disk,
+        Pack,
+        Mpq
+    };
+
+    struct PathIndexEntry
+    {
+        std::string path; ///< As it was first asked for, which is the spelling that exists for Disk entries
+        std::string stormPath;
+        PathLocation location = PathLocation::Missing;
+    };
+
+    struct ThreadPathIndex
+    {
+        uint32_t generation = 0;
+        std::unordered_map<uint64_t, PathIndexEntry> entries;
+        PathIndexEntry uncached; ///< Holds the result in the vanishingly unlikely event of a hash collision
+    };
+
+    std::atomic<uint32_t> pathIndexGeneration(1);
+    thread_local ThreadPathIndex threadPathIndex;
+
+    char foldPathChar(char c)
+    {
+        if (c == '\\')
+            return '/';
+        if (c >= 'A' && c <= 'Z')
+            return c - 'A' + 'a';
+        return c;
+    }
+
+    uint64_t hashPathNoCase(const std::string& path)
+    {
+        // FNV-1a
+        uint64_t hash = 14695981039346656037ull;
+        for (char c : path)
+        {
+            hash ^= uint8_t(foldPathChar(c));
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    bool samePathNoCase(const std::string& a, const std::string& b)
+    {
+        if (a.size() != b.size())
+            return false;
+
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            if (foldPathChar(a[i]) != foldPathChar(b[i]))
+                return false;
+        }
+        return true;
+    }
+
+    PathIndexEntry resolvePath(const std::string& filename)
+    {
+        PathIndexEntry entry;
+        entry.path = filename;
+
+        if (bfs::exists(filename))
+        {
+            entry.location = PathLocation::Disk;
+        }
+        else if (mountedPack && mountedPack->contains(filename))
+        {
+            entry.location = PathLocation::Pack;
+        }
+        else
+        {
+            bfs::path path(filename);
+            path.make_preferred();
+            entry.stormPath = getStormLibPath(path);
+
+            if (SFileHasFile(getArchive(), entry.stormPath.c_str()))
+                entry.location = PathLocation::Mpq;
+        }
+
+        return entry;
+    }
+
+    const PathIndexEntry& lookupPath(const std::string& filename)
+    {
+        ThreadPathIndex& index = threadPathIndex;
+
+        uint32_t generation = pathIndexGeneration;
+        if (index.generation != generation)
+        {
+            index.entries.clear();
+            index.generation = generation;
+        }
+
+        uint64_t hash = hashPathNoCase(filename);
+        auto it = index.entries.find(hash);
+
+        if (it == index.entries.end())
+            return index.entries.emplace(hash, resolvePath(filename)).first->second;
+
+        if (samePathNoCase(it->second.path, filename))
+            return it->second;
+
+        index.uncached = resolvePath(filename);
+        return index.uncached;
+    }
+
+    // Files read ahead by prefetch(). There are only ever a handful, so they're just searched in order, and the count lets
+    // the common case of there being none skip the lock.
+    struct PrefetchedFile
+    {
+        std::string path;
+        FileSpan contents;
+    };
+
+    std::mutex prefetchedMutex;
+    std::deque<PrefetchedFile> prefetchedFiles; ///< Oldest first
+    size_t prefetchedBytes = 0;
+    std::atomic<int32_t> numPrefetched(0);
+    constexpr size_t MAX_PREFETCHED_BYTES = 64 * 1024 * 1024;
+
+    FileSpan getPrefetched(const std::string& filename)
+    {
+        if (numPrefetched == 0)
+            return FileSpan();
+
+        std::lock_guard<std::mutex> lock(prefetchedMutex);
+        for (const auto& file : prefetchedFiles)
+        {
+            if (samePathNoCase(file.path, filename))
+                return file.contents;
+        }
+        return FileSpan();
+    }
+
+    void clearPrefetched()
+    {
+        std::lock_guard<std::mutex> lock(prefetchedMutex);
+        prefetchedFiles.clear();
+        prefetchedBytes = 0;
+        numPrefetched = 0;
+    }
 
     bool init(const std::string pathMPQ, const std::string listFile)
     {
+        quit();
+
         if (pathMPQ.empty())
         {
             std::cout << "skipping stormlib init - won't be able to read files in MPQ archives" << std::endl;
             return true;
         }
 
-        const bool success = SFileOpenArchive(pathMPQ.c_str(), 0, STREAM_FLAG_READ_ONLY, &diabdat);
-
-        if (!success)
         {
-            std::cerr << "Failed to open " << pathMPQ.c_str() << " with error " << GetLastError() << std::endl;
+            std::lock_guard<std::mutex> lock(archivesMutex);
+            archivePath = pathMPQ;
+            archiveListFile = listFile;
         }
 
-        if (!listFile.empty())
-            SFileAddListFile(diabdat, listFile.c_str());
+        // open the calling thread's handle now, so a missing MPQ is reported here
+        HANDLE archive = getArchive();
+        const bool success = archive != NULL;
+
+        std::lock_guard<std::mutex> lock(archivesMutex);
+        if (success)
+        {
+            ULONGLONG headerOffset = 0;
+            if (SFileGetFileInfo(archive, SFileMpqHeaderOffset, &headerOffset, sizeof(headerOffset), NULL))
+            {
+                archiveHeaderOffset = headerOffset;
+                archiveMapping = mapWholeFile(pathMPQ);
+            }
+        }
+        else
+        {
+            archivePath.clear();
+        }
 
         return success;
     }
@@ -63,7 +320,7 @@ namespace FAIO
     std::vector<std::string> listMpqFiles(const std::string& pattern)
     {
         SFILE_FIND_DATA findFileData;
-        HANDLE findHandle = SFileFindFirstFile(diabdat, pattern.c_str(), &findFileData, NULL);
+        HANDLE findHandle = SFileFindFirstFile(getArchive(), pattern.c_str(), &findFileData, NULL);
 
         std::vector<std::string> results;
 
@@ -81,26 +338,67 @@ namespace FAIO
 
     void quit()
     {
-        if (NULL != diabdat)
-        {
-            SFileCloseArchive(diabdat);
-        }
+        mountedPack.reset();
+        clearPrefetched();
+
+        std::lock_guard<std::mutex> lock(archivesMutex);
+
+        for (HANDLE archive : openArchives)
+            SFileCloseArchive(archive);
+
+        openArchives.clear();
+        archiveMapping.reset();
+        archivePath.clear();
+        archiveListFile.clear();
+        archiveGeneration++;
+        pathIndexGeneration++;
     }
 
-    bool exists(const std::string& filename)
+    bool mountPack(const std::string& path)
     {
-        bfs::path path(filename);
-        path.make_preferred();
+        std::unique_ptr<const Pack> pack = Pack::open(path);
+        if (!pack)
+            return false;
+
+        std::cout << "Mounted pack " << path << " with " << pack->numFiles() << " files" << std::endl;
+        mountedPack = std::move(pack);
+        pathIndexGeneration++;
+        return true;
+    }
 
-        if (bfs::exists(filename))
-            return true;
+    void prefetch(const std::string& filename)
+    {
+        if (getPrefetched(filename).isValid() || !exists(filename))
+            return;
 
-        std::lock_guard<std::mutex> lock(m);
-        std::string stormPath = getStormLibPath(path);
+        FileSpan contents = mapFile(filename);
+        if (!contents.isValid())
+            return;
 
-        return SFileHasFile(diabdat, stormPath.c_str());
+        // A mapping only reads anything when it's touched, so touch every page now rather than on first use
+        if (contents.isMapped())
+        {
+            volatile uint8_t sink = 0;
+            for (size_t i = 0; i < contents.size(); i += 4096)
+                sink ^= contents.data()[i];
+        }
+
+        std::lock_guard<std::mutex> lock(prefetchedMutex);
+
+        prefetchedBytes += contents.size();
+        prefetchedFiles.push_back(PrefetchedFile{filename, std::move(contents)});
+
+        while (prefetchedBytes > MAX_PREFETCHED_BYTES && prefetchedFiles.size() > 1)
+        {
+            prefetchedBytes -= prefetchedFiles.front().contents.size();
+            prefetchedFiles.pop_front();
+        }
+
+        numPrefetched = int32_t(prefetchedFiles.size());
     }
 
+    bool exists(const std::string& filename) { return lookupPath(filename).location != PathLocation::Missing; }
+
     FAFile* FAfopen(const std::string& filename)
     {
         if (Misc::StringUtils::endsWith(filename, "banner2.dun") || Misc::StringUtils::endsWith(filename, "dmagew.cl2") ||
@@ -112,47 +410,150 @@ namespace FAIO
                                   filename.c_str());
         }
 
-        bfs::path path(filename);
-        path.make_preferred();
+        auto openSpan = [](FileSpan&& span) -> FAFile* {
+            if (!span.isValid())
+                return NULL;
+
+            FAFile* file = new FAFile();
+            file->mode = FAFile::FAFileMode::SpanFile;
+            file->data.spanFile.span = new FileSpan(std::move(span));
+            file->data.spanFile.position = 0;
 
-        if (!bfs::exists(filename))
-        {
-            std::lock_guard<std::mutex> lock(m);
-            std::string stormPath = getStormLibPath(path);
+            return file;
+        };
+
+        FileSpan prefetched = getPrefetched(filename);
+        if (prefetched.isValid())
+            return openSpan(std::move(prefetched));
+
+        const PathIndexEntry& entry = lookupPath(filename);
 
-            if (!SFileHasFile(diabdat, stormPath.c_str()))
+        switch (entry.location)
+        {
+            case PathLocation::Missing:
             {
-                std::cerr << "File " << path << " not found" << std::endl;
+                std::cerr << "File " << filename << " not found" << std::endl;
                 return NULL;
             }
 
-            FAFile* file = new FAFile();
-            file->data.mpqFile = malloc(sizeof(HANDLE));
-
-            if (!SFileOpenFileEx(diabdat, stormPath.c_str(), 0, (HANDLE*)file->data.mpqFile))
+            case PathLocation::Disk:
             {
-                std::cerr << "Failed to open " << filename << " in " << DIABDAT_MPQ;
-                delete file;
-                return NULL;
+                FILE* plainFile = fopen(entry.path.c_str(), "rb");
+                if (plainFile == NULL)
+                    return NULL;
+
+                // the size is taken now, so FAsize doesn't need to keep the path around to stat it
+                long size = -1;
+                if (fseek(plainFile, 0, SEEK_END) == 0)
+                    size = ftell(plainFile);
+
+                if (size < 0 || fseek(plainFile, 0, SEEK_SET) != 0)
+                {
+                    fclose(plainFile);
+                    return NULL;
+                }
+
+                FAFile* file = new FAFile();
+                file->mode = FAFile::FAFileMode::PlainFile;
+                file->data.plainFile.file = plainFile;
+                file->data.plainFile.size = size_t(size);
+
+                return file;
             }
 
-            file->mode = FAFile::FAFileMode::MPQFile;
+            case PathLocation::Pack:
+                return openSpan(mountedPack->read(entry.path));
 
-            return file;
+            case PathLocation::Mpq:
+            {
+                FAFile* file = new FAFile();
+                file->data.mpqFile = malloc(sizeof(HANDLE));
+
+                if (!SFileOpenFileEx(getArchive(), entry.stormPath.c_str(), 0, (HANDLE*)file->data.mpqFile))
+                {
+                    std::cerr << "Failed to open " << filename << " in " << DIABDAT_MPQ;
+                    free(file->data.mpqFile);
+                    delete file;
+                    return NULL;
+                }
+
+                file->mode = FAFile::FAFileMode::MPQFile;
+
+                return file;
+            }
         }
-        else
+
+        return NULL;
+    }
+
+    FileSpan::FileSpan(std::vector<uint8_t>&& contents)
+    {
+        auto owned = std::make_shared<const std::vector<uint8_t>>(std::move(contents));
+        mData = owned->data();
+        mSize = owned->size();
+        mOwner = owned;
+    }
+
+    FileSpan mapFile(const std::string& filename)
+    {
+        FileSpan prefetched = getPrefetched(filename);
+        if (prefetched.isValid())
+            return prefetched;
+
+        const PathIndexEntry& entry = lookupPath(filename);
+
+        if (entry.location == PathLocation::Disk)
         {
-            FILE* plainFile = fopen(filename.c_str(), "rb");
-            if (plainFile == NULL)
-                return NULL;
+            if (auto mapping = mapWholeFile(entry.path))
+            {
+                FileSpan span;
+                span.mData = static_cast<const uint8_t*>(mapping->get_address());
+                span.mSize = mapping->get_size();
+                span.mMapped = true;
+                span.mOwner = mapping;
+                return span;
+            }
+        }
 
-            FAFile* file = new FAFile();
-            file->mode = FAFile::FAFileMode::PlainFile;
-            file->data.plainFile.file = plainFile;
-            file->data.plainFile.filename = new std::string(filename);
+        if (entry.location == PathLocation::Pack)
+            return mountedPack->read(entry.path);
 
-            return file;
+        FAFile* file = FAfopen(filename);
+        if (!file)
+            return FileSpan();
+
+        // An entry stored with no compression or encryption is just its bytes, sitting in the MPQ contiguously
+        if (file->mode == FAFile::FAFileMode::MPQFile && archiveMapping)
+        {
+            HANDLE mpqFile = *((HANDLE*)file->data.mpqFile);
+            DWORD flags = 0;
+            ULONGLONG byteOffset = 0;
+            size_t size = FAsize(file);
+
+            if (SFileGetFileInfo(mpqFile, SFileInfoFlags, &flags, sizeof(flags), NULL) &&
+                SFileGetFileInfo(mpqFile, SFileInfoByteOffset, &byteOffset, sizeof(byteOffset), NULL) &&
+                (flags & (MPQ_FILE_COMPRESS_MASK | MPQ_FILE_ENCRYPTED)) == 0)
+            {
+                uint64_t offset = archiveHeaderOffset + byteOffset;
+                if (offset + size <= archiveMapping->get_size())
+                {
+                    FileSpan span;
+                    span.mData = static_cast<const uint8_t*>(archiveMapping->get_address()) + offset;
+                    span.mSize = size;
+                    span.mMapped = true;
+                    span.mOwner = archiveMapping;
+
+                    FAfclose(file);
+                    return span;
+                }
+            }
         }
+
+        std::vector<uint8_t> contents(FAsize(file));
+        contents.resize(FAfread(contents.data(), 1, contents.size(), file));
+        FAfclose(file);
+
+        return FileSpan(std::move(contents));
     }
 
     size_t FAfread(void* ptr, size_t size, size_t count, FAFile* stream)
@@ -164,8 +565,6 @@ namespace FAIO
 
             case FAFile::FAFileMode::MPQFile:
             {
-                std::lock_guard<std::mutex> lock(m);
-
                 DWORD dwBytes = 1;
                 if (!SFileReadFile(*((HANDLE*)stream->data.mpqFile), ptr, size * count, &dwBytes, NULL))
                 {
@@ -182,6 +581,21 @@ namespace FAIO
 
                 return dwBytes;
             }
+
+            case FAFile::FAFileMode::SpanFile:
+            {
+                const FileSpan& span = *stream->data.spanFile.span;
+                size_t& position = stream->data.spanFile.position;
+
+                if (size == 0 || position >= span.size())
+                    return 0;
+
+                size_t bytes = std::min(size * count, span.size() - position);
+                memcpy(ptr, span.data() + position, bytes);
+                position += bytes;
+
+                return bytes / size;
+            }
         }
         return 0;
     }
@@ -194,15 +608,12 @@ namespace FAIO
         {
             case FAFile::FAFileMode::PlainFile:
             {
-                delete stream->data.plainFile.filename;
                 retval = fclose(stream->data.plainFile.file);
                 break;
             }
 
             case FAFile::FAFileMode::MPQFile:
             {
-                std::lock_guard<std::mutex> lock(m);
-
                 int res = SFileCloseFile(*((HANDLE*)stream->data.mpqFile));
                 free(stream->data.mpqFile);
 
@@ -211,6 +622,12 @@ namespace FAIO
 
                 break;
             }
+
+            case FAFile::FAFileMode::SpanFile:
+            {
+                delete stream->data.spanFile.span;
+                break;
+            }
         }
 
         delete stream;
@@ -227,7 +644,6 @@ namespace FAIO
 
             case FAFile::FAFileMode::MPQFile:
             {
-                std::lock_guard<std::mutex> lock(m);
                 DWORD moveMethod;
 
                 switch (origin)
@@ -248,11 +664,35 @@ namespace FAIO
                         return 1; // error, incorrect origin
                 }
 
-                SFileSetFilePointer(*((HANDLE*)stream->data.mpqFile), offset, NULL, moveMethod);
-                int nError = ERROR_SUCCESS;
-                nError = GetLastError();
+                // StormLib's last error is shared between threads off windows, so go by the return value, which is -1 on failure
+                return SFileSetFilePointer(*((HANDLE*)stream->data.mpqFile), offset, NULL, moveMethod) == DWORD(-1);
+            }
+
+            case FAFile::FAFileMode::SpanFile:
+            {
+                size_t base;
+
+                switch (origin)
+                {
+                    case SEEK_SET:
+                        base = 0;
+                        break;
+
+                    case SEEK_CUR:
+                        base = stream->data.spanFile.position;
+                        break;
+
+                    case SEEK_END:
+                        base = stream->data.spanFile.span->size();
+                        break;
+
+                    default:
+                        return 1; // error, incorrect origin
+                }
 
-                return nError != ERROR_SUCCESS;
+                // offset is unsigned, so going backwards relies on it wrapping, as with the other modes
+                stream->data.spanFile.position = base + offset;
+                return 0;
             }
         }
 
@@ -268,10 +708,12 @@ namespace FAIO
 
             case FAFile::FAFileMode::MPQFile:
             {
-                std::lock_guard<std::mutex> lock(m);
                 return SFileSetFilePointer(*((HANDLE*)stream->data.mpqFile), 0, NULL, FILE_CURRENT);
             }
 
+            case FAFile::FAFileMode::SpanFile:
+                return stream->data.spanFile.position;
+
             default:
                 return 0;
         }
@@ -282,13 +724,15 @@ namespace FAIO
         switch (stream->mode)
         {
             case FAFile::FAFileMode::PlainFile:
-                return static_cast<size_t>(bfs::file_size(*(stream->data.plainFile.filename)));
+                return stream->data.plainFile.size;
 
             case FAFile::FAFileMode::MPQFile:
             {
-                std::lock_guard<std::mutex> lock(m);
                 return SFileGetFileSize(*((HANDLE*)stream->data.mpqFile), NULL);
             }
+
+            case FAFile::FAFileMode::SpanFile:
+                return stream->data.spanFile.span->size();
         }
 
         return 0;
@@ -4,16 +4,23 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#include <memory>
 #include <string>
 #include <vector>
 
 // The functions in this header are designed to behave roughly like the normal fopen, fread family.
 // The difference is, if FAfopen is called on a file that doesn't exist, it will try to use StormLib
-// to open it in the MPQ file DIABDAT.MPQ.
+// to open it in the MPQ file DIABDAT.MPQ, or first in a pack of files extracted from it, if one has been mounted with mountPack.
+// Paths are case insensitive, and / and \ are interchangeable. Where each one was found is remembered, so opening the
+// same file again doesn't search the disk, pack and MPQ again.
+// Every thread reads the MPQ through its own handle, so none of these ever wait on each other. The catch is that an
+// FAFile opened from the MPQ must only be used on the thread that opened it.
 
 namespace FAIO
 {
-    // A FILE* like container for either a normal FILE*, or a StormLib HANDLE
+    class FileSpan;
+
+    // A FILE* like container for either a normal FILE*, a StormLib HANDLE, or a file already in memory (from a Pack or prefetch)
     struct FAFile
     {
     private:
@@ -22,15 +29,21 @@ namespace FAIO
             struct
             {
                 FILE* file;
-                std::string* filename;
+                size_t size;
             } plainFile;
             void* mpqFile; // This is a pointer to a StormLib HANDLE type, I jist didn't want to #include StormLib here
+            struct
+            {
+                FileSpan* span;
+                size_t position;
+            } spanFile;
         } data;
 
         enum class FAFileMode
         {
             PlainFile,
-            MPQFile
+            MPQFile,
+            SpanFile
         } mode;
 
         FAFile();
@@ -41,15 +54,50 @@ namespace FAIO
         friend int FAfseek(FAFile* stream, size_t offset, int origin);
         friend size_t FAftell(FAFile* stream);
         friend size_t FAsize(FAFile* stream);
+        friend FileSpan mapFile(const std::string& filename);
+    };
+
+    /// The whole contents of a file, read only. Plain files, and files stored uncompressed in the MPQ, point straight into
+    /// a memory mapping with no copy at all. Anything else (most of DIABDAT.MPQ is compressed) is read into a buffer the span owns.
+    /// Unlike an FAFile, a FileSpan can be handed between threads, and stays valid after quit().
+    class FileSpan
+    {
+    public:
+        FileSpan() = default;
+        explicit FileSpan(std::vector<uint8_t>&& contents);
+
+        const uint8_t* data() const { return mData; }
+        size_t size() const { return mSize; }
+        bool isValid() const { return mOwner != nullptr; }
+        bool isMapped() const { return mMapped; } ///< false if the contents had to be copied
+
+    private:
+        const uint8_t* mData = nullptr;
+        size_t mSize = 0;
+        bool mMapped = false;
+        std::shared_ptr<const void> mOwner; ///< The mapping or buffer mData points into
+
+        friend FileSpan mapFile(const std::string& filename);
+        friend class Pack;
     };
 
     bool init(const std::string pathMPQ = "DIABDAT.MPQ", const std::string listFile = "");
     std::vector<std::string> listMpqFiles(const std::string& pattern);
 
-    void quit();
+    void quit(); ///< Also unmounts the pack
+
+    /// Looks in the pack at path (see mpqtool --pack) before the MPQ, until quit(). Files on disk still come first.
+    /// Must be called after init(), and not while other threads are reading.
+    bool mountPack(const std::string& path);
 
     bool exists(const std::string& filename);
     FAFile* FAfopen(const std::string& filename);
+    FileSpan mapFile(const std::string& filename); ///< Returns an invalid FileSpan if the file can't be opened
+
+    /// Reads filename into memory, so that FAfopen and mapFile can hand it over without touching the disk or MPQ.
+    /// Meant to be called on a background thread shortly before the file is needed. Prefetched files are kept until
+    /// newer ones push them out of a fixed budget, or quit() is called.
+    void prefetch(const std::string& filename);
     size_t FAfread(void* ptr, size_t size, size_t count, FAFile* stream);
     int FAfclose(FAFile* stream);
     int FAfseek(FAFile* stream, size_t offset, int origin);
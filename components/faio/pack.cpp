@@ -0,0 +1,286 @@
+#include "pack.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+#ifdef FA_PACK_LZ4
+#include <lz4.h>
+#endif
+
+namespace FAIO
+{
+    namespace
+    {
+        const char PACK_MAGIC[4] = {'F', 'A', 'P', 'K'};
+    }
+
+    constexpr uint32_t Pack::VERSION;
+
+    std::unique_ptr<Pack> Pack::open(const std::string& path)
+    {
+        std::unique_ptr<Pack> pack(new Pack());
+        pack->mContents = mapFile(path);
+
+        const FileSpan& contents = pack->mContents;
+        if (!contents.isValid())
+        {
+            std::cerr << "Failed to open pack " << path << std::endl;
+            return nullptr;
+        }
+
+        Header header;
+        if (contents.size() < sizeof(header))
+        {
+            std::cerr << path << " is not a pack" << std::endl;
+            return nullptr;
+        }
+
+        memcpy(&header, contents.data(), sizeof(header));
+        if (memcmp(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC)) != 0)
+        {
+            std::cerr << path << " is not a pack" << std::endl;
+            return nullptr;
+        }
+
+        if (header.version != VERSION)
+        {
+            std::cerr << "Pack " << path << " is version " << header.version << ", expected " << VERSION << ", it needs to be made again" << std::endl;
+            return nullptr;
+        }
+
+        // Check everything up front, so lookups can trust the table
+        uint64_t size = contents.size();
+        bool valid = header.entriesOffset % alignof(Entry) == 0 && header.entriesOffset <= size &&
+                     header.numEntries <= (size - header.entriesOffset) / sizeof(Entry) && header.pathsOffset <= size;
+
+        if (valid)
+        {
+            pack->mEntries = reinterpret_cast<const Entry*>(contents.data() + header.entriesOffset);
+            pack->mNumEntries = header.numEntries;
+            pack->mPaths = reinterpret_cast<const char*>(contents.data() + header.pathsOffset);
+
+            uint64_t pathsSize = size - header.pathsOffset;
+            for (uint32_t i = 0; i < header.numEntries && valid; i++)
+            {
+                const Entry& entry = pack->mEntries[i];
+                valid = entry.offset <= size && entry.storedSize <= size - entry.offset && uint64_t(entry.pathOffset) + entry.pathLength <= pathsSize &&
+                        (i == 0 || pack->mEntries[i - 1].pathHash <= entry.pathHash);
+            }
+        }
+
+        if (!valid)
+        {
+            std::cerr << "Pack " << path << " is corrupt" << std::endl;
+            return nullptr;
+        }
+
+        return pack;
+    }
+
+    const Pack::Entry* Pack::find(const std::string& normalisedPath) const
+    {
+        if (mNumEntries == 0)
+            return nullptr;
+
+        uint64_t hash = hashPath(normalisedPath);
+
+        // Where the hash would be if the hashes were perfectly evenly spread, which is never more than a few slots out
+        size_t i = size_t(((hash >> 32) * mNumEntries) >> 32);
+
+        while (i > 0 && mEntries[i - 1].pathHash >= hash)
+            i--;
+        while (i < mNumEntries && mEntries[i].pathHash < hash)
+            i++;
+
+        for (; i < mNumEntries && mEntries[i].pathHash == hash; i++)
+        {
+            const Entry& entry = mEntries[i];
+            if (entry.pathLength == normalisedPath.size() && memcmp(mPaths + entry.pathOffset, normalisedPath.data(), entry.pathLength) == 0)
+                return &entry;
+        }
+
+        return nullptr;
+    }
+
+    FileSpan Pack::read(const std::string& filename) const
+    {
+        const Entry* entry = find(normalisePath(filename));
+        if (!entry)
+            return FileSpan();
+
+        if (entry->storedSize == entry->size)
+        {
+            FileSpan span;
+            span.mData = mContents.mData + entry->offset;
+            span.mSize = entry->size;
+            span.mMapped = mContents.mMapped;
+            span.mOwner = mContents.mOwner;
+            return span;
+        }
+
+#ifdef FA_PACK_LZ4
+        std::vector<uint8_t> contents(entry->size);
+        int decompressed = LZ4_decompress_safe(
+            reinterpret_cast<const char*>(mContents.data() + entry->offset), reinterpret_cast<char*>(contents.data()), entry->storedSize, entry->size);
+
+        if (decompressed == int(entry->size))
+            return FileSpan(std::move(contents));
+
+        std::cerr << "Failed to decompress " << filename << " from pack" << std::endl;
+#else
+        std::cerr << "Can't read " << filename << " from pack, it's compressed and this build has no LZ4 support (FA_PACK_LZ4)" << std::endl;
+#endif
+        return FileSpan();
+    }
+
+    std::string Pack::normalisePath(const std::string& path)
+    {
+        std::string normalised;
+        normalised.reserve(path.size());
+
+        for (char c : path)
+        {
+            if (c == '\\')
+                c = '/';
+            else if (c >= 'A' && c <= 'Z')
+                c = c - 'A' + 'a';
+
+            // collapse repeated separators
+            if (c == '/' && !normalised.empty() && normalised.back() == '/')
+                continue;
+
+            normalised += c;
+        }
+
+        while (normalised.compare(0, 2, "./") == 0)
+            normalised.erase(0, 2);
+        if (!normalised.empty() && normalised[0] == '/')
+            normalised.erase(0, 1);
+
+        return normalised;
+    }
+
+    uint64_t Pack::hashPath(const std::string& normalisedPath)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (char c : normalisedPath)
+        {
+            hash ^= uint8_t(c);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    bool Pack::compressionSupported()
+    {
+#ifdef FA_PACK_LZ4
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    PackWriter::PackWriter(const std::string& path, bool compress) : mCompress(compress)
+    {
+        if (mCompress && !Pack::compressionSupported())
+        {
+            std::cerr << "Can't compress packs, this build has no LZ4 support (FA_PACK_LZ4)" << std::endl;
+            return;
+        }
+
+        mFile = fopen(path.c_str(), "wb");
+        if (!mFile)
+        {
+            std::cerr << "Failed to open " << path << " for writing" << std::endl;
+            return;
+        }
+
+        // filled in by finish(), once the offsets are known
+        Pack::Header header = {};
+        write(&header, sizeof(header));
+    }
+
+    PackWriter::~PackWriter()
+    {
+        if (mFile)
+            fclose(mFile);
+    }
+
+    bool PackWriter::write(const void* data, size_t size)
+    {
+        if (size > 0 && fwrite(data, 1, size, mFile) != size)
+            mOk = false;
+
+        mOffset += size;
+        return mOk;
+    }
+
+    bool PackWriter::add(const std::string& filename, const uint8_t* data, size_t size)
+    {
+        std::string path = Pack::normalisePath(filename);
+
+        if (!mFile || size > std::numeric_limits<uint32_t>::max() || !mAdded.insert(path).second)
+            return false;
+
+        Pack::Entry entry = {};
+        entry.pathHash = Pack::hashPath(path);
+        entry.offset = mOffset;
+        entry.size = uint32_t(size);
+        entry.storedSize = uint32_t(size);
+        entry.pathOffset = uint32_t(mPaths.size());
+        entry.pathLength = uint32_t(path.size());
+
+        const uint8_t* stored = data;
+
+#ifdef FA_PACK_LZ4
+        if (mCompress && size > 0 && size <= LZ4_MAX_INPUT_SIZE)
+        {
+            mCompressed.resize(LZ4_compressBound(int(size)));
+            int compressedSize = LZ4_compress_default(reinterpret_cast<const char*>(data), reinterpret_cast<char*>(mCompressed.data()), int(size), int(mCompressed.size()));
+
+            // an entry is compressed exactly when its stored size differs, so anything that doesn't shrink is kept as is
+            if (compressedSize > 0 && size_t(compressedSize) < size)
+            {
+                entry.storedSize = uint32_t(compressedSize);
+                stored = mCompressed.data();
+            }
+        }
+#endif
+
+        mEntries.push_back(entry);
+        mPaths.insert(mPaths.end(), path.begin(), path.end());
+
+        return write(stored, entry.storedSize);
+    }
+
+    bool PackWriter::finish()
+    {
+        if (!mFile)
+            return false;
+
+        std::sort(mEntries.begin(), mEntries.end(), [](const Pack::Entry& a, const Pack::Entry& b) { return a.pathHash < b.pathHash; });
+
+        // the table is used in place from the mapping, so needs aligning
+        const uint8_t padding[alignof(Pack::Entry)] = {};
+        write(padding, (alignof(Pack::Entry) - mOffset % alignof(Pack::Entry)) % alignof(Pack::Entry));
+
+        Pack::Header header = {};
+        memcpy(header.magic, PACK_MAGIC, sizeof(PACK_MAGIC));
+        header.version = Pack::VERSION;
+        header.numEntries = uint32_t(mEntries.size());
+
+        header.entriesOffset = mOffset;
+        write(mEntries.data(), mEntries.size() * sizeof(Pack::Entry));
+
+        header.pathsOffset = mOffset;
+        write(mPaths.data(), mPaths.size());
+
+        mOk = mOk && fseek(mFile, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, mFile) == 1;
+        mOk = fclose(mFile) == 0 && mOk;
+        mFile = nullptr;
+
+        return mOk;
+    }
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "faio.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace FAIO
+{
+    ///
+    /// @brief A read only archive of files extracted from the MPQ, made with mpqtool --pack
+    ///
+    /// When one is mounted (see mountPack), FAIO looks in it ahead of the MPQ, so reads skip StormLib and its PKWARE
+    /// decompression entirely. The layout is a Header, every file's contents back to back, each stored as is or LZ4
+    /// compressed, then the Entry table sorted by path hash, then the normalised paths the entries point at.
+    ///
+    /// Path hashes are close to uniformly distributed, so an entry is found by jumping to the slot its hash predicts
+    /// and scanning the few slots around it, rather than by a binary search. The path is only compared once the hash
+    /// has matched, to rule out collisions.
+    ///
+    /// A Pack is never modified after it's opened, so all methods can be called from any thread.
+    ///
+    class Pack
+    {
+    public:
+        static constexpr uint32_t VERSION = 1;
+
+        /// Returns nullptr, after printing why, if path can't be read as a pack
+        static std::unique_ptr<Pack> open(const std::string& path);
+
+        bool contains(const std::string& filename) const { return find(normalisePath(filename)) != nullptr; }
+
+        /// Uncompressed entries point straight into the pack's mapping, compressed ones are decompressed into a buffer.
+        /// Returns an invalid FileSpan if the pack has no such file.
+        FileSpan read(const std::string& filename) const;
+
+        size_t numFiles() const { return mNumEntries; }
+
+        /// Lower case with / separators and no leading ./ or /, so however a caller spells a path it finds the same entry
+        static std::string normalisePath(const std::string& path);
+        static uint64_t hashPath(const std::string& normalisedPath); ///< 64 bit FNV-1a
+
+        /// false when built without FA_PACK_LZ4, in which case compressed entries can neither be written nor read
+        static bool compressionSupported();
+
+        struct Header
+        {
+            char magic[4];
+            uint32_t version;
+            uint32_t numEntries;
+            uint32_t reserved;
+            uint64_t entriesOffset;
+            uint64_t pathsOffset;
+        };
+
+        struct Entry
+        {
+            uint64_t pathHash;
+            uint64_t offset;
+            uint32_t size;       ///< Size of the file
+            uint32_t storedSize; ///< Size of the file in the pack, the same as size unless it's compressed
+            uint32_t pathOffset; ///< Relative to Header::pathsOffset
+            uint32_t pathLength;
+        };
+
+    private:
+        Pack() = default;
+        const Entry* find(const std::string& normalisedPath) const;
+
+        FileSpan mContents;
+        const Entry* mEntries = nullptr;
+        uint32_t mNumEntries = 0;
+        const char* mPaths = nullptr;
+    };
+
+    ///
+    /// @brief Writes a Pack, one file at a time
+    ///
+    /// Contents are written out as they're added, so only the entry table is held in memory.
+    ///
+    class PackWriter
+    {
+    public:
+        /// @param compress LZ4 compress each file, where that makes it smaller. Needs Pack::compressionSupported().
+        PackWriter(const std::string& path, bool compress);
+        ~PackWriter();
+
+        bool isOpen() const { return mFile != nullptr; }
+
+        /// Returns false if the write failed, or a file with the same normalised path was already added
+        bool add(const std::string& filename, const uint8_t* data, size_t size);
+
+        /// Writes the entry table and closes the file. Returns false if anything failed along the way.
+        bool finish();
+
+    private:
+        bool write(const void* data, size_t size);
+
+        FILE* mFile = nullptr;
+        bool mCompress;
+        bool mOk = true;
+        uint64_t mOffset = 0;
+        std::vector<Pack::Entry> mEntries;
+        std::vector<char> mPaths;
+        std::unordered_set<std::string> mAdded;
+        std::vector<uint8_t> mCompressed;
+    };
+}
@@ -1,26 +1,33 @@
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <stdio.h>
 
 #include "dun.h"
 
-#include <faio/fafileobject.h>
+#include <faio/faio.h>
 #include <serial/loader.h>
 
 namespace Level
 {
     Dun::Dun(const std::string& filename)
     {
-        FAIO::FAFileObject f(filename);
-
-        int16_t width, height;
-        f.FAfread(&width, 2, 1);
-        f.FAfread(&height, 2, 1);
-
-        std::vector<int16_t> buf(width * height);
-        f.FAfread(buf.data(), 2, width * height);
-
-        std::vector<int32_t> data(buf.size());
-        std::copy(buf.begin(), buf.end(), data.begin());
+        FAIO::FileSpan f = FAIO::mapFile(filename);
+
+        // anything missing off the end of the file reads as 0
+        auto read16 = [&f](size_t index) {
+            int16_t value = 0;
+            if ((index + 1) * 2 <= f.size())
+                memcpy(&value, f.data() + index * 2, 2);
+            return value;
+        };
+
+        int16_t width = read16(0);
+        int16_t height = read16(1);
+
+        std::vector<int32_t> data(std::max(width * height, 0));
+        for (size_t i = 0; i < data.size(); i++)
+            data[i] = read16(i + 2);
 
         mBlocks = Misc::Array2D<int32_t>(width, height, std::move(data));
     }
@@ -1,5 +1,6 @@
 #include "level.h"
 
+#include <atomic>
 #include <iostream>
 #include <serial/loader.h>
 
@@ -21,6 +22,7 @@ namespace Level
           mDun(std::move(dun)), mTil(mTilPath), mMin(mMinPath), mSol(mSolPath), mDoorMap(doorMap), mUpStairs(upStairs), mDownStairs(downStairs),
           mPrevious(previous), mNext(next)
     {
+        updateTiles();
     }
 
     Level::Level(Serial::Loader& loader)
@@ -53,6 +55,8 @@ namespace Level
 
         mPrevious = loader.load<int32_t>();
         mNext = loader.load<int32_t>();
+
+        updateTiles();
     }
 
     void Level::save(Serial::Saver& saver)
@@ -105,51 +109,47 @@ namespace Level
         return false;
     }
 
-    MinPillar Level::get(const Misc::Point& point) const
+    void Level::updateTiles()
     {
-        int32_t xDunIndex = point.x;
-        int32_t xTilIndex = 0;
-        if ((xDunIndex % 2) != 0)
-        {
-            xDunIndex--;
-            xTilIndex = 1;
-        }
-        xDunIndex /= 2;
+        mTilePillars.resize(width(), height());
+        mPassable.assign((size_t(width()) * height() + 63) / 64, 0);
 
-        int32_t yDunIndex = point.y;
-        int32_t yTilIndex = 0;
-        if ((yDunIndex % 2) != 0)
+        for (int32_t y = 0; y < mDun.height(); y++)
         {
-            yDunIndex--;
-            yTilIndex = 1;
+            for (int32_t x = 0; x < mDun.width(); x++)
+                updateTiles(x, y);
         }
-        yDunIndex /= 2;
+    }
 
-        int32_t tilIndex;
+    void Level::updateTiles(int32_t xDun, int32_t yDun)
+    {
+        int32_t dunIndex = mDun.get(xDun, yDun) - 1;
 
-        if (xTilIndex)
-        {
-            if (yTilIndex)
-                tilIndex = 3; // bottom
-            else
-                tilIndex = 1; // left
-        }
-        else
+        // til blocks are in the order top, left, right, bottom
+        for (int32_t tilIndex = 0; tilIndex < 4; tilIndex++)
         {
-            if (yTilIndex)
-                tilIndex = 2; // right
+            int32_t x = xDun * 2 + (tilIndex & 1);
+            int32_t y = yDun * 2 + (tilIndex >> 1);
+
+            int32_t minIndex = dunIndex == -1 ? -1 : mTil[dunIndex][tilIndex];
+            mTilePillars.get(x, y) = minIndex;
+
+            size_t bit = x + size_t(y) * width();
+            if (minIndex != -1 && mSol.passable(minIndex))
+                mPassable[bit / 64] |= uint64_t(1) << (bit % 64);
             else
-                tilIndex = 0; // top
+                mPassable[bit / 64] &= ~(uint64_t(1) << (bit % 64));
         }
+    }
 
-        int32_t dunIndex = mDun.get(xDunIndex, yDunIndex) - 1;
-
-        if (dunIndex == -1)
-            return MinPillar(Level::mEmpty, 0, -1);
+    MinPillar Level::get(const Misc::Point& point) const
+    {
+        int32_t minIndex = mTilePillars.get(point.x, point.y);
 
-        int32_t minIndex = mTil[dunIndex][tilIndex];
+        if (minIndex == -1)
+            return MinPillar(Level::mEmpty.data(), Level::mEmpty.size(), false, -1);
 
-        return MinPillar(mMin[minIndex], mSol.passable(minIndex), minIndex);
+        return MinPillar(mMin[minIndex], mMin.pillarSize(), isPassable(point), minIndex);
     }
 
     bool Level::isDoor(const Misc::Point& point) const
@@ -198,6 +198,8 @@ namespace Level
             if (mDoorMap.find(index) != mDoorMap.end())
             {
                 mDun.get(xDunIndex, yDunIndex) = mDoorMap[index];
+                updateTiles(xDunIndex, yDunIndex);
+                mVersion = newVersion();
                 return true;
             }
         }
@@ -205,9 +207,15 @@ namespace Level
         return false;
     }
 
+    int32_t Level::newVersion()
+    {
+        static std::atomic<int32_t> nextVersion(0);
+        return nextVersion++;
+    }
+
     int32_t Level::minSize() const { return mMin.size(); }
 
-    const MinPillar Level::minPillar(int32_t i) const { return MinPillar(mMin[i], mSol.passable(i), i); }
+    const MinPillar Level::minPillar(int32_t i) const { return MinPillar(mMin[i], mMin.pillarSize(), mSol.passable(i), i); }
 
     int32_t Level::width() const { return mDun.width() * 2; }
 
@@ -225,9 +233,9 @@ namespace Level
 
     const std::string& Level::getMinPath() const { return mMinPath; }
 
-    MinPillar::MinPillar(const std::vector<int16_t>& data, bool passable, int32_t index) : mData(data), mPassable(passable), mIndex(index) {}
+    MinPillar::MinPillar(const int16_t* data, int32_t size, bool passable, int32_t index) : mData(data), mSize(size), mPassable(passable), mIndex(index) {}
 
-    int32_t MinPillar::size() const { return mData.size(); }
+    int32_t MinPillar::size() const { return mSize; }
 
     int16_t MinPillar::operator[](int32_t index) const { return mData[index]; }
 
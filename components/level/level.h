@@ -29,8 +29,9 @@ namespace Level
         int32_t index() const;
 
     private:
-        MinPillar(const std::vector<int16_t>& data, bool passable, int32_t index);
-        const std::vector<int16_t>& mData;
+        MinPillar(const int16_t* data, int32_t size, bool passable, int32_t index);
+        const int16_t* mData;
+        int32_t mSize;
 
         bool mPassable;
         int32_t mIndex;
@@ -69,6 +70,16 @@ namespace Level
 
         MinPillar get(const Misc::Point& point) const;
 
+        /// Whether the tile's pillar can be walked on, false outside the level. Doesn't know about actors, see GameLevel::isPassable.
+        bool isPassable(const Misc::Point& point) const
+        {
+            if (uint32_t(point.x) >= uint32_t(mTilePillars.width()) || uint32_t(point.y) >= uint32_t(mTilePillars.height()))
+                return false;
+
+            size_t bit = point.x + size_t(point.y) * mTilePillars.width();
+            return (mPassable[bit / 64] >> (bit % 64)) & 1;
+        }
+
         int32_t width() const;
         int32_t height() const;
 
@@ -86,7 +97,17 @@ namespace Level
 
         int32_t getPreviousLevel() const { return mPrevious; }
 
+        /// Changes whenever the tiles of the level do (eg. when a door is opened), and is never shared between two levels,
+        /// so the renderer can use it to tell when geometry it has cached for a level is out of date.
+        int32_t version() const { return mVersion; }
+
     private:
+        static int32_t newVersion();
+
+        /// mTilePillars and mPassable are worked out from the dun up front, rather than on every get()
+        void updateTiles();                            ///< Every tile
+        void updateTiles(int32_t xDun, int32_t yDun); ///< The 2x2 tiles covered by one dun block
+
         std::string mTilesetCelPath;               ///< path to cel file for level
         std::string mSpecialCelPath;               ///< path to special cel file for level (mostly used for arches / open doors).
         std::map<int32_t, int32_t> mSpecialCelMap; ///< Map from tileset frame number to special cel frame number
@@ -98,6 +119,8 @@ namespace Level
         TileSet mTil;
         Min mMin;
         Sol mSol;
+        Misc::Array2D<int32_t> mTilePillars; ///< Min index of each tile, -1 for none. Must be kept up to date with mDun.
+        std::vector<uint64_t> mPassable;      ///< One bit per tile, in the same order as mTilePillars
 
         std::map<int32_t, int32_t> mDoorMap; ///< Map from closed door indices to open door indices + vice-versa
 
@@ -109,5 +132,7 @@ namespace Level
 
         int32_t mPrevious; ///< index of previous level
         int32_t mNext;     ///< index of next level
+
+        int32_t mVersion = newVersion();
     };
 }
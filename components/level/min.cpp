@@ -1,38 +1,28 @@
 #include "min.h"
 
+#include <cstring>
 #include <iostream>
 #include <stdio.h>
 
-#include <faio/fafileobject.h>
+#include <faio/faio.h>
 #include <misc/stringops.h>
 
 namespace Level
 {
     Min::Min(const std::string& filename)
     {
-        FAIO::FAFileObject minF(filename);
+        FAIO::FileSpan minF = FAIO::mapFile(filename);
 
-        size_t minSize;
         // These two files contain 16 blocks, all else are 10. Nothing to do but a workaround...
         if (Misc::StringUtils::endsWith(filename, "l4.min") || Misc::StringUtils::endsWith(filename, "town.min"))
-            minSize = 16;
+            mPillarSize = 16;
         else
-            minSize = 10;
+            mPillarSize = 10;
 
-        size_t numPillars = minF.FAsize() / (minSize * 2);
+        size_t numPillars = minF.size() / (mPillarSize * 2);
 
-        minF.FAfseek(0, SEEK_SET);
-
-        std::vector<int16_t> temp(minSize);
-
-        for (size_t i = 0; i < numPillars; i++)
-        {
-            minF.FAfread(&temp[0], 2, minSize);
-            mPillars.push_back(std::vector<int16_t>(temp));
-        }
+        mData.resize(numPillars * mPillarSize);
+        if (!mData.empty())
+            memcpy(mData.data(), minF.data(), mData.size() * 2);
     }
-
-    const std::vector<int16_t>& Min::operator[](size_t index) const { return mPillars[index]; }
-
-    size_t Min::size() const { return mPillars.size(); }
 }
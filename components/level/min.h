@@ -7,16 +7,19 @@
 
 namespace Level
 {
+    /// The pillars of a tileset, stored back to back in one array, as every pillar in a file has the same number of entries
     class Min
     {
     public:
         Min(const std::string&);
         Min() {}
 
-        const std::vector<int16_t>& operator[](size_t index) const;
-        size_t size() const;
+        const int16_t* operator[](size_t index) const { return &mData[index * mPillarSize]; } ///< pillarSize() entries
+        size_t size() const { return mPillarSize ? mData.size() / mPillarSize : 0; }
+        size_t pillarSize() const { return mPillarSize; } ///< 16 for the town and l4, 10 for the rest
 
     private:
-        std::vector<std::vector<int16_t>> mPillars;
+        std::vector<int16_t> mData;
+        size_t mPillarSize = 0;
     };
 }
@@ -1,36 +1,90 @@
 
 #pragma once
 
+#include <functional>
+#include <memory>
+#include <stdint.h>
 #include <string>
+#include <vector>
 
 struct SDL_Surface;
 
 namespace Render
 {
-    typedef void* Sprite;
+    /// A rectangle of a texture holding one sprite frame. Standalone sprites cover their whole texture,
+    /// atlased ones share a texture page with many other frames.
+    struct TextureReference
+    {
+        uint32_t texture = 0;
+        int32_t x = 0;
+        int32_t y = 0;
+        int32_t width = 0;
+        int32_t height = 0;
+        float u0 = 0.0f;
+        float v0 = 0.0f;
+        float u1 = 1.0f;
+        float v1 = 1.0f;
+        int32_t palette = -1; ///< palette row for TextureFormat::IndexAlpha textures, -1 for RGBA ones
+    };
+
+    typedef const TextureReference* Sprite;
     typedef SDL_Surface* FASurface;
 
+    class TextureAtlas;
+    struct SpriteData;
+
     class SpriteGroup
     {
     public:
         SpriteGroup(const std::string& path);
-        SpriteGroup(const std::vector<Sprite> sprites) : mSprites(sprites), mAnimLength(sprites.size()) {}
+        explicit SpriteGroup(const SpriteData& data); ///< Uploads decoded frames into an atlas, render thread only
+        SpriteGroup(std::vector<TextureReference>&& frames, std::shared_ptr<TextureAtlas> atlas = nullptr)
+            : mFrames(std::move(frames)), mAtlas(atlas), mAnimLength(mFrames.size())
+        {
+        }
         void destroy();
 
-        Sprite& operator[](size_t index);
-        size_t size() { return mSprites.size(); }
+        /// Bytes of texture memory used by the frames, or by the whole atlas if they have one
+        int64_t memoryUsage() const;
+
+        Sprite operator[](size_t index);
+        size_t size() { return mFrames.size(); }
+
+        /// Splits an archive's frames into directions (subcels), each of which can then be uploaded into an atlas of its own
+        /// and freed again without touching the others. The frames the group was made with (normally a placeholder's) stand in
+        /// for any direction that isn't loaded.
+        void setNumDirections(size_t numDirections);
+        size_t numDirections() const { return mDirections.size(); }
+        void loadDirection(size_t direction, const SpriteData& data); ///< data holds just that direction's frames, render thread only
+        void unloadDirection(size_t direction);
+        bool isDirectionLoaded(size_t direction) const { return mDirections[direction].atlas != nullptr; }
+        bool takeDirectionUsed(size_t direction); ///< Whether operator[] returned a frame of the direction since the last call
+
+        /// Called from operator[] the first time a frame of a direction that isn't loaded is asked for, so loading can start that same frame.
+        /// Called again after the direction is unloaded.
+        void setDirectionRequestHandler(std::function<void(size_t direction)> handler) { mDirectionRequestHandler = std::move(handler); }
 
         size_t animLength() { return mAnimLength; }
-        int32_t getWidth() const { return mWidth; }
-        int32_t getHeight() const { return mHeight; }
+        int32_t getWidth(size_t frame = 0) const { return mFrames[frame].width; }
+        int32_t getHeight(size_t frame = 0) const { return mFrames[frame].height; }
 
         static void toPng(const std::string& celPath, const std::string& pngPath);
         static void toGif(const std::string& celPath, const std::string& gifPath);
 
     private:
-        std::vector<Sprite> mSprites;
-        int32_t mWidth, mHeight;
+        std::vector<TextureReference> mFrames;
+        std::shared_ptr<TextureAtlas> mAtlas; ///< Owns the textures of all frames when set, otherwise the frames own their textures
         size_t mAnimLength;
+
+        struct Direction
+        {
+            std::shared_ptr<TextureAtlas> atlas; ///< Owns the textures of the direction's frames while it's loaded
+            bool used = false;
+            bool requested = false;
+        };
+        std::vector<Direction> mDirections;
+        std::vector<TextureReference> mUnloadedFrames; ///< What each frame goes back to when its direction is unloaded
+        std::function<void(size_t direction)> mDirectionRequestHandler;
     };
 
     class SpriteCacheBase
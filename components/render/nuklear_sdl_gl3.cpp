@@ -7,13 +7,6 @@
 #include <misc/assert.h>
 #include <string.h>
 
-struct nk_sdl_vertex
-{
-    float position[2];
-    float uv[2];
-    nk_byte col[4];
-};
-
 static const struct nk_draw_vertex_layout_element vertex_layout[] = {{NK_VERTEX_POSITION, NK_FORMAT_FLOAT, NK_OFFSETOF(struct nk_sdl_vertex, position)},
                                                                      {NK_VERTEX_TEXCOORD, NK_FORMAT_FLOAT, NK_OFFSETOF(struct nk_sdl_vertex, uv)},
                                                                      {NK_VERTEX_COLOR, NK_FORMAT_R8G8B8A8, NK_OFFSETOF(struct nk_sdl_vertex, col)},
@@ -42,6 +35,8 @@ void nk_sdl_device_create(nk_gl_device& dev)
     static const GLchar* fragment_shader = NK_SHADER_VERSION
         R"(precision mediump float;
         uniform sampler2D Texture;
+        uniform sampler2D Palette;
+        uniform float paletteRow;
         in vec2 Frag_UV;
         in vec4 Frag_Color;
         out vec4 Out_Color;
@@ -52,14 +47,23 @@ void nk_sdl_device_create(nk_gl_device& dev)
         uniform float imgW;
         uniform float imgH;
         uniform int checkerboarded;
+        uniform vec4 uvRect;
+        vec2 atlasUv(vec2 uv) { return uvRect.xy + uv * uvRect.zw; }
+        vec4 texel(vec2 coord) {
+             vec4 t = texture(Texture, coord);
+             if (paletteRow < 0.)
+               return t;
+             vec4 c = texelFetch(Palette, ivec2(int(t.r * 255. + 0.5), int(paletteRow)), 0);
+             return vec4(c.rgb, t.g);
+        }
         void main(){
-             vec4 c = Frag_Color * texture(Texture, Frag_UV.st);
+             vec4 c = Frag_Color * texel(atlasUv(Frag_UV.st));
              if (c.w == 0. && h_color_a > 0.)
                 {
                   for (float i= -1.; i <= 1.; i++)
                     for (float j= -1.; j <= 1.; j++)
                         {
-                          vec4 n = texture(Texture, vec2 (Frag_UV.st.x + i/imgW, Frag_UV.st.y + j/imgH));
+                          vec4 n = texel(atlasUv(vec2 (Frag_UV.st.x + i/imgW, Frag_UV.st.y + j/imgH)));
                           if (n.w > 0. && (n.x > 0. || n.y > 0. || n.z > 0.))
                             c = vec4 (h_color_r, h_color_g, h_color_b, h_color_a);
                         }
@@ -115,7 +119,10 @@ void nk_sdl_device_create(nk_gl_device& dev)
     dev.uniform_checkerboarded = glGetUniformLocation(dev.prog, "checkerboarded");
     dev.imgW = glGetUniformLocation(dev.prog, "imgW");
     dev.imgH = glGetUniformLocation(dev.prog, "imgH");
+    dev.uniform_uv_rect = glGetUniformLocation(dev.prog, "uvRect");
     dev.uniform_tex = glGetUniformLocation(dev.prog, "Texture");
+    dev.uniform_palette = glGetUniformLocation(dev.prog, "Palette");
+    dev.uniform_palette_row = glGetUniformLocation(dev.prog, "paletteRow");
     dev.uniform_proj = glGetUniformLocation(dev.prog, "ProjMtx");
     dev.attrib_pos = glGetAttribLocation(dev.prog, "Position");
     dev.attrib_uv = glGetAttribLocation(dev.prog, "TexCoord");
@@ -217,6 +224,7 @@ void nk_sdl_render_dump(Render::SpriteCacheBase* cache, NuklearFrameDump& dump,
     // setup program
     glUseProgram(dev.prog);
     glUniform1i(dev.uniform_tex, 0);
+    glUniform1i(dev.uniform_palette, 1);
 
     glUniformMatrix4fv(dev.uniform_proj, 1, GL_FALSE, &ortho[0][0]);
     {
@@ -255,17 +263,17 @@ void nk_sdl_render_dump(Render::SpriteCacheBase* cache, NuklearFrameDump& dump,
 
             Render::SpriteGroup* sprite = cache->get(cacheIndex);
             auto s = sprite->operator[](frameNum);
-            glBindTexture(GL_TEXTURE_2D, (GLuint)(intptr_t)s);
-            int32_t w, h;
-            Render::spriteSize(s, w, h);
+            glBindTexture(GL_TEXTURE_2D, s->texture);
+            glUniform4f(dev.uniform_uv_rect, s->u0, s->v0, s->u1 - s->u0, s->v1 - s->v0);
+            glUniform1f(dev.uniform_palette_row, static_cast<float>(s->palette));
             int item_hl_color[] = {0xB9, 0xAA, 0x77};
             glUniform1f(dev.uniform_hcolor_r, item_hl_color[0] / 255.f);
             glUniform1f(dev.uniform_hcolor_g, item_hl_color[1] / 255.f);
             glUniform1f(dev.uniform_hcolor_b, item_hl_color[2] / 255.f);
             glUniform1f(dev.uniform_hcolor_a, effect == FAGui::EffectType::highlighted ? 1.0f : 0.0f);
             glUniform1i(dev.uniform_checkerboarded, effect == FAGui::EffectType::checkerboarded ? 1 : 0);
-            glUniform1f(dev.imgW, w);
-            glUniform1f(dev.imgH, h);
+            glUniform1f(dev.imgW, s->width);
+            glUniform1f(dev.imgH, s->height);
 
             glScissor((GLint)(cmd.clip_rect.x * scale.x),
                       (GLint)((height - (GLint)(cmd.clip_rect.y + cmd.clip_rect.h)) * scale.y),
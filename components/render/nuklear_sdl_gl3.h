@@ -8,6 +8,13 @@
 
 #include <fa_nuklear.h>
 
+struct nk_sdl_vertex
+{
+    float position[2];
+    float uv[2];
+    nk_byte col[4];
+};
+
 struct nk_gl_device
 {
     nk_buffer cmds;
@@ -27,6 +34,9 @@ struct nk_gl_device
     GLint uniform_checkerboarded;
     GLint imgW;
     GLint imgH;
+    GLint uniform_uv_rect;
+    GLint uniform_palette;
+    GLint uniform_palette_row;
     GLint uniform_proj;
     nk_handle font_tex;
 };
@@ -20,7 +20,6 @@ class SpriteGroup;
 
 namespace Render
 {
-    typedef void* Sprite;
     typedef void* FACursor;
     typedef SDL_Surface* FASurface;
 }
@@ -67,6 +66,7 @@ namespace Render
         int32_t windowWidth;
         int32_t windowHeight;
         bool fullscreen;
+        bool headless = false; ///< render into system memory with the software renderer, without creating a window
     };
 
     struct NuklearGraphicsContext
@@ -86,7 +86,8 @@ namespace Render
     RenderSettings getWindowSize();
     void drawGui(NuklearFrameDump& dump, SpriteCacheBase* cache);
 
-    bool getImageInfo(const std::string& path, std::vector<int32_t>& widths, std::vector<int32_t>& heights, int32_t& animLength);
+    /// Sizes of the frames of one animation, ie. of the first subcel of an archive, which has numFrames / animLength subcels
+    bool getImageInfo(const std::string& path, std::vector<int32_t>& widths, std::vector<int32_t>& heights, int32_t& animLength, int32_t& numFrames);
     FACursor createCursor(const Cel::CelFrame& celFrame, int32_t hot_x = 0, int32_t hot_y = 0);
     void freeCursor(FACursor cursor);
     void drawCursor(FACursor cursor);
@@ -103,6 +104,17 @@ namespace Render
 
     void draw();
 
+    /// Sprite batcher counters for the last presented frame
+    struct RenderStats
+    {
+        uint32_t drawCalls = 0;
+        uint32_t vertices = 0;
+    };
+    RenderStats getRenderStats();
+
+    /// Saves the current contents of the back buffer (or software framebuffer when headless) to a png file
+    bool saveScreenshot(const std::string& pngPath);
+
     void handleEvents();
 
     void drawSprite(const Sprite& sprite, int32_t x, int32_t y, boost::optional<Cel::Colour> highlightColor = boost::none);
@@ -118,6 +130,30 @@ namespace Render
     void spriteSize(const Sprite& sprite, int32_t& w, int32_t& h);
 
     SpriteGroup* loadTilesetSprite(const std::string& celPath, const std::string& minPath, bool top);
+
+    /// The decoded pixels of a sprite group, ie. the part of loading one that doesn't need the render thread.
+    /// The decode functions below don't touch GL or the palette table, so they can run on any thread,
+    /// SpriteGroup(const SpriteData&) then does the upload.
+    struct SpriteData
+    {
+        struct Frame
+        {
+            int32_t width = 0;
+            int32_t height = 0;
+            std::vector<uint8_t> pixels; ///< TextureFormat::IndexAlpha
+        };
+
+        Cel::Pal palette;
+        std::vector<Frame> frames;
+        int32_t animLength = 0;
+    };
+
+    SpriteData decodeCelSprite(const std::string& path, int32_t firstFrame = 0, int32_t numFrames = -1); ///< numFrames -1 for the rest of the file
+    /// Composites the pillars straight from the decoded tiles, with the work spread over numThreads threads, 0 for one per core
+    SpriteData decodeTilesetSprite(const std::string& celPath, const std::string& minPath, bool top, int32_t numThreads = 0);
+
+    /// Invisible frames of the given sizes, to draw in place of a sprite that is still being decoded
+    SpriteGroup* createPlaceholderSprite(const std::vector<int32_t>& widths, const std::vector<int32_t>& heights);
     void drawLevel(const Level::Level& level,
                    size_t minTopsHandle,
                    size_t minBottomsHandle,
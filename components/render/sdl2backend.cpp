@@ -1,6 +1,8 @@
 #include "render.h"
 
+#include <algorithm>
 #include <complex>
+#include <cstring>
 #include <iostream>
 
 #include <SDL.h>
@@ -8,6 +10,10 @@
 #include <SDL_image.h>
 
 #include "sdl_gl_funcs.h"
+#include "softwarerenderer.h"
+#include "spritebatcher.h"
+#include "texture.h"
+#include "textureatlas.h"
 
 #include "../cel/celfile.h"
 #include "../cel/celframe.h"
@@ -65,10 +71,82 @@ namespace Render
     // SDL_Renderer* renderer;
     SDL_GLContext glContext;
 
+    SpriteBatcher spriteBatcher;
+    GLuint shaderProgram = 0;
+    RenderStats lastFrameStats;
+
+    bool headless = false;
+    SoftwareRenderer softwareRenderer;
+
+    GLuint paletteTexture = 0;
+    std::vector<std::vector<uint8_t>> palettes; ///< RGBA copies of every added palette, to find duplicates
+
+    static GLuint compileShader(GLenum type, const std::string& path)
+    {
+        std::string src = Misc::StringUtils::readAsString(path);
+        const GLchar* srcPtr = src.c_str();
+
+        GLuint shader = glCreateShader(type);
+        glShaderSource(shader, 1, &srcPtr, NULL);
+        glCompileShader(shader);
+
+        GLint isCompiled = 0;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &isCompiled);
+        if (isCompiled == GL_FALSE)
+        {
+            GLint maxLength = 0;
+            glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &maxLength);
+
+            // The maxLength includes the NULL character
+            std::vector<GLchar> errorLog(maxLength);
+            glGetShaderInfoLog(shader, maxLength, &maxLength, &errorLog[0]);
+
+            std::cout << path << ": " << &errorLog[0] << std::endl;
+        }
+        release_assert(isCompiled == GL_TRUE);
+
+        return shader;
+    }
+
+    static GLuint createShaderProgram(const std::string& vertPath, const std::string& fragPath)
+    {
+        GLuint vs = compileShader(GL_VERTEX_SHADER, vertPath);
+        GLuint fs = compileShader(GL_FRAGMENT_SHADER, fragPath);
+
+        GLuint program = glCreateProgram();
+        glAttachShader(program, fs);
+        glAttachShader(program, vs);
+        glLinkProgram(program);
+
+        GLint status = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        release_assert(status == GL_TRUE);
+
+        glDetachShader(program, fs);
+        glDetachShader(program, vs);
+        glDeleteShader(fs);
+        glDeleteShader(vs);
+
+        return program;
+    }
+
     void init(const std::string& title, const RenderSettings& settings, NuklearGraphicsContext& nuklearGraphics, nk_context* nk_ctx)
     {
         WIDTH = settings.windowWidth;
         HEIGHT = settings.windowHeight;
+
+        headless = settings.headless;
+        if (headless)
+        {
+            SDL_Init(SDL_INIT_EVENTS | SDL_INIT_AUDIO);
+            softwareRenderer.resize(WIDTH, HEIGHT);
+
+            if (nk_ctx)
+                memset(&nuklearGraphics, 0, sizeof(nuklearGraphics));
+
+            return;
+        }
+
         int flags = SDL_WINDOW_OPENGL;
 
         if (settings.fullscreen)
@@ -115,6 +193,23 @@ namespace Render
 
         glDisable(GL_CULL_FACE);
         glDisable(GL_DEPTH_TEST);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        // IndexAlpha rows are only 2 byte aligned
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+        // The palette texture stays bound to unit 1 for good, everything else only uses unit 0
+        glActiveTexture(GL_TEXTURE1);
+        glGenTextures(1, &paletteTexture);
+        glBindTexture(GL_TEXTURE_2D, paletteTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 256, MAX_PALETTES, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glActiveTexture(GL_TEXTURE0);
+
+        shaderProgram = createShaderProgram("resources/shaders/basic.vert", "resources/shaders/basic.frag");
+        spriteBatcher.init(shaderProgram);
 
         if (nk_ctx)
         {
@@ -123,16 +218,37 @@ namespace Render
         }
     }
 
-    void setWindowSize(const RenderSettings& settings) { SDL_SetWindowSize(screen, settings.windowWidth, settings.windowHeight); }
+    void setWindowSize(const RenderSettings& settings)
+    {
+        if (headless)
+            resize(settings.windowWidth, settings.windowHeight);
+        else
+            SDL_SetWindowSize(screen, settings.windowWidth, settings.windowHeight);
+    }
 
     void destroyNuklearGraphicsContext(NuklearGraphicsContext& nuklearGraphics)
     {
         nk_font_atlas_clear(&nuklearGraphics.atlas);
-        nk_sdl_device_destroy(nuklearGraphics.dev);
+        if (!headless)
+            nk_sdl_device_destroy(nuklearGraphics.dev);
     }
 
+    static void clearFloorCache();
+
     void quit()
     {
+        clearFloorCache();
+
+        if (headless)
+        {
+            SDL_Quit();
+            return;
+        }
+
+        spriteBatcher.destroy();
+        glDeleteProgram(shaderProgram);
+        glDeleteTextures(1, &paletteTexture);
+
         SDL_GL_DeleteContext(glContext);
         // SDL_DestroyRenderer(renderer);
         SDL_DestroyWindow(screen);
@@ -146,6 +262,9 @@ namespace Render
         WIDTH = w;
         HEIGHT = h;
         resized = true;
+
+        if (headless)
+            softwareRenderer.resize(WIDTH, HEIGHT);
     }
 
     RenderSettings getWindowSize()
@@ -158,16 +277,129 @@ namespace Render
         return settings;
     }
 
-    GLuint getGLTexFromSurface(SDL_Surface* surf)
+    int32_t bytesPerPixel(TextureFormat format)
     {
-        GLenum data_fmt = GL_RGBA;
-        /*Uint8 test = SDL_MapRGB(surf->format, 0xAA, 0xBB, 0xCC) & 0xFF;
-        if (test == 0xAA) data_fmt = GL_RGB;
-        else if (test == 0xCC) data_fmt = GL_BGR;//GL_BGR;
-        else {
-        printf("Error: \"Loaded surface was neither RGB or BGR!\""); return;
-        }*/
+        switch (format)
+        {
+            case TextureFormat::RGBA:
+                return 4;
+            case TextureFormat::IndexAlpha:
+                return 2;
+        }
 
+        invalid_enum(TextureFormat, format);
+    }
+
+    static GLenum glPixelFormat(TextureFormat format) { return format == TextureFormat::IndexAlpha ? GL_RG : GL_RGBA; }
+
+    uint32_t createTexture(int32_t width, int32_t height, const uint8_t* pixels, TextureFormat format)
+    {
+        if (headless)
+            return softwareRenderer.createTexture(width, height, pixels, format);
+
+        GLuint tex = 0;
+
+        glGenTextures(1, &tex);
+        glBindTexture(GL_TEXTURE_2D, tex);
+
+        // Interpolating palette indices would produce nonsense colours, and sprites are drawn 1:1 anyway
+        GLint filter = GL_LINEAR;
+        if (format == TextureFormat::IndexAlpha)
+        {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RG8, width, height, 0, GL_RG, GL_UNSIGNED_BYTE, pixels);
+            filter = GL_NEAREST;
+        }
+        else
+        {
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        }
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+
+        return tex;
+    }
+
+    void updateTexture(uint32_t texture, int32_t x, int32_t y, int32_t width, int32_t height, const uint8_t* pixels, TextureFormat format)
+    {
+        if (headless)
+            return softwareRenderer.updateTexture(texture, x, y, width, height, pixels);
+
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, glPixelFormat(format), GL_UNSIGNED_BYTE, pixels);
+    }
+
+    void deleteTexture(uint32_t texture)
+    {
+        if (headless)
+            return softwareRenderer.deleteTexture(texture);
+
+        // Queued quads only keep the texture name, so they have to be drawn before it can be freed and handed out again
+        spriteBatcher.flush();
+
+        GLuint tex = texture;
+        glDeleteTextures(1, &tex);
+    }
+
+    int32_t maxTextureSize()
+    {
+        if (headless)
+            return 2048;
+
+        GLint size = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &size);
+        return size;
+    }
+
+    static std::vector<uint8_t> paletteToRgba(const Cel::Pal& pal)
+    {
+        std::vector<uint8_t> rgba(256 * 4);
+        for (int32_t i = 0; i < 256; i++)
+        {
+            rgba[i * 4 + 0] = pal[i].r;
+            rgba[i * 4 + 1] = pal[i].g;
+            rgba[i * 4 + 2] = pal[i].b;
+            rgba[i * 4 + 3] = 255;
+        }
+
+        return rgba;
+    }
+
+    int32_t addPalette(const Cel::Pal& pal)
+    {
+        std::vector<uint8_t> rgba = paletteToRgba(pal);
+
+        for (size_t i = 0; i < palettes.size(); i++)
+        {
+            if (palettes[i] == rgba)
+                return i;
+        }
+
+        release_assert(palettes.size() < size_t(MAX_PALETTES));
+
+        int32_t palette = palettes.size();
+        palettes.push_back(rgba);
+        updatePalette(palette, pal);
+
+        return palette;
+    }
+
+    void updatePalette(int32_t palette, const Cel::Pal& pal)
+    {
+        debug_assert(palette >= 0 && size_t(palette) < palettes.size());
+
+        palettes[palette] = paletteToRgba(pal);
+
+        if (headless)
+            return softwareRenderer.setPalette(palette, palettes[palette].data());
+
+        glActiveTexture(GL_TEXTURE1);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, palette, 256, 1, GL_RGBA, GL_UNSIGNED_BYTE, palettes[palette].data());
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    TextureReference createTextureFromSurface(SDL_Surface* surf)
+    {
         bool validFormat = true;
         if (surf->format->BitsPerPixel != 24 && surf->format->BitsPerPixel != 32)
             validFormat = false;
@@ -184,22 +416,15 @@ namespace Render
 
         debug_assert(surf->pitch == 4 * surf->w);
 
-        GLuint tex = 0;
-
-        glGenTextures(1, &tex);
-        glBindTexture(GL_TEXTURE_2D, tex);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, surf->w, surf->h, 0, data_fmt, GL_UNSIGNED_BYTE, surf->pixels);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        int32_t w, h;
-        spriteSize((Sprite)(intptr_t)tex, w, h);
+        TextureReference ref;
+        ref.texture = createTexture(surf->w, surf->h, (const uint8_t*)surf->pixels);
+        ref.width = surf->w;
+        ref.height = surf->h;
 
         if (!validFormat)
             SDL_FreeSurface(surf);
 
-        return tex;
+        return ref;
     }
 
     void drawGui(NuklearFrameDump& dump, SpriteCacheBase* cache)
@@ -209,6 +434,10 @@ namespace Render
         // defaults everything back into a default state.
         // Make sure to either a.) save and restore or b.) reset your own state after
         // rendering the UI.
+        if (headless)
+            return softwareRenderer.drawGui(dump, cache);
+
+        spriteBatcher.flush();
         nk_sdl_render_dump(cache, dump, screen);
 
         glEnable(GL_BLEND); // see above comment
@@ -243,26 +472,77 @@ namespace Render
         return path.substr(i + 1, path.length() - i);
     }
 
-    bool getImageInfo(const std::string& path, std::vector<int32_t>& widths, std::vector<int32_t>& heights, int32_t& animLength)
+    /// Reads the size of a pcx or png from its header, returns false for anything else
+    static bool peekImageSize(const std::string& path, const std::string& extension, int32_t& width, int32_t& height)
     {
-        // TODO: get better image decoders that allow you to peek image dimensions without loading full image
+        bool pcx = Misc::StringUtils::ciEqual(extension, "pcx");
+        bool png = Misc::StringUtils::ciEqual(extension, "png");
+        if (!pcx && !png)
+            return false;
+
+        FAIO::FAFileObject file(path);
+        if (!file.isValid())
+            return false;
+
+        uint8_t header[24];
+        size_t headerSize = pcx ? 12 : 24;
+        if (file.FAfread(header, 1, headerSize) != headerSize)
+            return false;
 
+        if (pcx)
+        {
+            // manufacturer byte, then xMin, yMin, xMax, yMax as little endian 16 bit values
+            if (header[0] != 0x0A)
+                return false;
+
+            auto read16 = [&](int32_t offset) { return int32_t(header[offset]) | (int32_t(header[offset + 1]) << 8); };
+            width = read16(8) - read16(4) + 1;
+            height = read16(10) - read16(6) + 1;
+        }
+        else
+        {
+            // signature, then the IHDR chunk, which must come first and starts with big endian 32 bit width and height
+            static const uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+            if (memcmp(header, signature, sizeof(signature)) != 0 || memcmp(header + 12, "IHDR", 4) != 0)
+                return false;
+
+            auto read32 = [&](int32_t offset) {
+                return int32_t((uint32_t(header[offset]) << 24) | (uint32_t(header[offset + 1]) << 16) | (uint32_t(header[offset + 2]) << 8) |
+                               uint32_t(header[offset + 3]));
+            };
+            width = read32(16);
+            height = read32(20);
+        }
+
+        return width > 0 && height > 0;
+    }
+
+    bool getImageInfo(const std::string& path, std::vector<int32_t>& widths, std::vector<int32_t>& heights, int32_t& animLength, int32_t& numFrames)
+    {
         std::string extension = getImageExtension(path);
 
         if (Misc::StringUtils::ciEqual(extension, "cel") || Misc::StringUtils::ciEqual(extension, "cl2"))
         {
-            Cel::CelFile cel(path);
-            widths.resize(cel.animLength());
-            heights.resize(cel.animLength());
-            for (int i = 0; i < cel.animLength(); ++i)
-            {
-                widths[i] = cel[i].width();
-                heights[i] = cel[i].height();
-            }
-            animLength = cel.animLength();
+            Cel::CelDecoder::getFrameSizes(path, widths, heights, animLength);
+            numFrames = widths.size();
+
+            // callers expect one size per frame of an animation, and for archives that's just the first subcel
+            widths.resize(animLength);
+            heights.resize(animLength);
         }
         else
         {
+            int32_t width, height;
+            if (peekImageSize(path, extension, width, height))
+            {
+                widths = {width};
+                heights = {height};
+                animLength = 1;
+                numFrames = 1;
+                return true;
+            }
+
+            // unusual format, decode it to find out
             SDL_Surface* surface = loadNonCelImage(path, extension);
 
             if (surface)
@@ -270,6 +550,7 @@ namespace Render
                 widths = {surface->w};
                 heights = {surface->h};
                 animLength = 1;
+                numFrames = 1;
 
                 SDL_FreeSurface(surface);
             }
@@ -325,12 +606,12 @@ namespace Render
         {
             SDL_Surface* tmp = loadNonCelImageTrans(path, extension, hasTrans, transR, transG, transB);
 
-            std::vector<Sprite> vec(1);
-            vec[0] = (Sprite)(intptr_t)getGLTexFromSurface(tmp);
+            std::vector<TextureReference> vec(1);
+            vec[0] = createTextureFromSurface(tmp);
 
             SDL_FreeSurface(tmp);
 
-            return new SpriteGroup(vec);
+            return new SpriteGroup(std::move(vec));
         }
     }
 
@@ -345,7 +626,7 @@ namespace Render
 
         std::cout << original->w;
 
-        std::vector<Sprite> vec;
+        std::vector<TextureReference> vec;
 
         for (size_t srcY = 0; srcY < (size_t)original->h - 1; srcY += vAnim)
         {
@@ -361,7 +642,7 @@ namespace Render
                 }
             }
 
-            vec.push_back((Render::Sprite)(intptr_t)getGLTexFromSurface(tmp));
+            vec.push_back(createTextureFromSurface(tmp));
 
             clearTransparentSurface(tmp);
         }
@@ -369,7 +650,7 @@ namespace Render
         SDL_FreeSurface(original);
         SDL_FreeSurface(tmp);
 
-        return new SpriteGroup(vec);
+        return new SpriteGroup(std::move(vec));
     }
 
     SpriteGroup* loadResizedSprite(
@@ -416,13 +697,13 @@ namespace Render
                 break;
         }
 
-        std::vector<Sprite> vec(1);
-        vec[0] = (Sprite)(intptr_t)getGLTexFromSurface(tmp);
+        std::vector<TextureReference> vec(1);
+        vec[0] = createTextureFromSurface(tmp);
 
         SDL_FreeSurface(original);
         SDL_FreeSurface(tmp);
 
-        return new SpriteGroup(vec);
+        return new SpriteGroup(std::move(vec));
     }
 
     SpriteGroup* loadCelToSingleTexture(const std::string& path)
@@ -450,12 +731,12 @@ namespace Render
             x += cel[i].width();
         }
 
-        std::vector<Sprite> vec(1);
-        vec[0] = (Sprite)(intptr_t)getGLTexFromSurface(surface);
+        std::vector<TextureReference> vec(1);
+        vec[0] = createTextureFromSurface(surface);
 
         SDL_FreeSurface(surface);
 
-        return new SpriteGroup(vec);
+        return new SpriteGroup(std::move(vec));
     }
 
     SpriteGroup* loadTiledTexture(const std::string& sourcePath, size_t width, size_t height, bool hasTrans, size_t transR, size_t transG, size_t transB)
@@ -482,13 +763,13 @@ namespace Render
             }
         }
 
-        std::vector<Sprite> vec(1);
-        vec[0] = (Sprite)(intptr_t)getGLTexFromSurface(texture);
+        std::vector<TextureReference> vec(1);
+        vec[0] = createTextureFromSurface(texture);
 
         SDL_FreeSurface(texture);
         SDL_FreeSurface(tile);
 
-        return new SpriteGroup(vec);
+        return new SpriteGroup(std::move(vec));
     }
 
     SpriteGroup* loadNonCelSprite(const std::string& path)
@@ -496,16 +777,19 @@ namespace Render
         std::string extension = getImageExtension(path);
         SDL_Surface* image = loadNonCelImage(path, extension);
 
-        std::vector<Sprite> vec(1);
-        vec[0] = (Sprite)(intptr_t)getGLTexFromSurface(image);
+        std::vector<TextureReference> vec(1);
+        vec[0] = createTextureFromSurface(image);
 
         SDL_FreeSurface(image);
 
-        return new SpriteGroup(vec);
+        return new SpriteGroup(std::move(vec));
     }
 
     FACursor createCursor(const Cel::CelFrame& celFrame, int32_t hot_x, int32_t hot_y)
     {
+        if (headless)
+            return NULL;
+
         auto surface = createTransparentSurface(celFrame.width(), celFrame.height());
         drawFrame(surface, 0, 0, celFrame);
         auto cursor = SDL_CreateColorCursor(surface, hot_x, hot_y);
@@ -517,6 +801,9 @@ namespace Render
 
     void drawCursor(FACursor cursor)
     {
+        if (headless)
+            return;
+
         if (cursor == NULL)
         {
             cursor = (FACursor)SDL_GetDefaultCursor();
@@ -544,253 +831,241 @@ namespace Render
         // SDL_Texture *tex = SDL_CreateTextureFromSurface(renderer, surface);
         // SDL_SetTextureBlendMode(tex, SDL_BLENDMODE_BLEND);
 
-        std::vector<Sprite> vec(1);
-        vec[0] = (Sprite)(intptr_t)getGLTexFromSurface(surface);
+        std::vector<TextureReference> vec(1);
+        vec[0] = createTextureFromSurface(surface);
 
         SDL_FreeSurface(surface);
 
-        return new SpriteGroup(vec);
+        return new SpriteGroup(std::move(vec));
     }
 
-    bool once = false;
-
-    GLuint vao = 0;
-    GLuint shader_programme = 0;
-    GLuint texture = 0;
-
     void draw()
     {
-        if (!once)
+        if (headless)
         {
+            lastFrameStats.drawCalls = softwareRenderer.drawCalls();
+            lastFrameStats.vertices = softwareRenderer.vertices();
+            softwareRenderer.resetStats();
+            return;
+        }
 
-            glEnable(GL_BLEND);
-            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        spriteBatcher.flush();
 
-            once = true;
+        lastFrameStats.drawCalls = spriteBatcher.drawCalls();
+        lastFrameStats.vertices = spriteBatcher.vertices();
+        spriteBatcher.resetStats();
 
-            float points[] = {0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 0, 0, 1, 1, 0, 0, 1, 0};
+        SDL_GL_SwapWindow(screen);
+        // SDL_RenderPresent(renderer);
+    }
 
-            float colours[] = {0, 0, 1, 0, 1, 1, 0, 0, 1, 1, 0, 1};
+    RenderStats getRenderStats() { return lastFrameStats; }
 
-            GLuint vbo = 0;
-            glGenBuffers(1, &vbo);
-            glBindBuffer(GL_ARRAY_BUFFER, vbo);
-            glBufferData(GL_ARRAY_BUFFER, 18 * sizeof(float), points, GL_STATIC_DRAW);
+    bool saveScreenshot(const std::string& pngPath)
+    {
+        std::vector<uint8_t> pixels;
+        if (headless)
+        {
+            pixels.assign(softwareRenderer.pixels(), softwareRenderer.pixels() + WIDTH * HEIGHT * 4);
+        }
+        else
+        {
+            spriteBatcher.flush();
 
-            GLuint uvs_vbo = 0;
-            glGenBuffers(1, &uvs_vbo);
-            glBindBuffer(GL_ARRAY_BUFFER, uvs_vbo);
-            glBufferData(GL_ARRAY_BUFFER, 12 * sizeof(float), colours, GL_STATIC_DRAW);
+            // GL hands rows back bottom-up
+            std::vector<uint8_t> flipped(WIDTH * HEIGHT * 4);
+            glReadPixels(0, 0, WIDTH, HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, flipped.data());
 
-            glGenVertexArrays(1, &vao);
-            glBindVertexArray(vao);
-            glBindBuffer(GL_ARRAY_BUFFER, vbo);
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-            glBindBuffer(GL_ARRAY_BUFFER, uvs_vbo);
-            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, NULL);
+            pixels.resize(flipped.size());
+            for (int32_t y = 0; y < HEIGHT; y++)
+                memcpy(&pixels[y * WIDTH * 4], &flipped[(HEIGHT - 1 - y) * WIDTH * 4], WIDTH * 4);
+        }
 
-            glEnableVertexAttribArray(0);
-            glEnableVertexAttribArray(1);
+        SDL_Surface* surface = createTransparentSurface(WIDTH, HEIGHT);
+        for (int32_t y = 0; y < HEIGHT; y++)
+            memcpy((uint8_t*)surface->pixels + y * surface->pitch, &pixels[y * WIDTH * 4], WIDTH * 4);
 
-            std::string src = Misc::StringUtils::readAsString("resources/shaders/basic.vert");
-            const GLchar* srcPtr = src.c_str();
+        bool success = SDL_SavePNG(surface, pngPath.c_str()) == 0;
+        SDL_FreeSurface(surface);
 
-            GLuint vs = glCreateShader(GL_VERTEX_SHADER);
-            glShaderSource(vs, 1, &srcPtr, NULL);
-            glCompileShader(vs);
+        return success;
+    }
 
-            GLint isCompiled = 0;
-            glGetShaderiv(vs, GL_COMPILE_STATUS, &isCompiled);
-            if (isCompiled == GL_FALSE)
-            {
-                GLint maxLength = 0;
-                glGetShaderiv(vs, GL_INFO_LOG_LENGTH, &maxLength);
+    void handleEvents()
+    {
+        SDL_Event event;
+        while (SDL_PollEvent(&event))
+        {
+            // do nothing, just clear the event queue to avoid render window hang up in ubuntu.
+        }
+    }
 
-                // The maxLength includes the NULL character
-                std::vector<GLchar> errorLog(maxLength);
-                glGetShaderInfoLog(vs, maxLength, &maxLength, &errorLog[0]);
+    void drawSprite(const Sprite& sprite, int32_t x, int32_t y, boost::optional<Cel::Colour> highlightColor)
+    {
+        if (headless)
+            return softwareRenderer.drawSprite(*sprite, x, y, highlightColor);
 
-                std::cout << &errorLog[0] << std::endl;
+        spriteBatcher.draw(sprite->texture, sprite->palette, x, y, sprite->width, sprite->height, sprite->u0, sprite->v0, sprite->u1, sprite->v1, highlightColor);
+    }
 
-                // Provide the infolog in whatever manor you deem best.
-                // Exit with failure.
-                glDeleteShader(vs); // Don't leak the shader.
-                return;
-            }
+    constexpr auto tileHeight = 32;
+    constexpr auto tileWidth = tileHeight * 2;
 
-            src = Misc::StringUtils::readAsString("resources/shaders/basic.frag");
-            srcPtr = src.c_str();
+    void drawAtTile(const Sprite& sprite, const Misc::Point& tileTop, int spriteW, int spriteH, boost::optional<Cel::Colour> highlightColor = boost::none)
+    {
+        // centering spright at the center of tile by width and at the bottom of tile by height
+        drawSprite(sprite, tileTop.x - spriteW / 2, tileTop.y - spriteH + tileHeight, highlightColor);
+    }
 
-            GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
-            glShaderSource(fs, 1, &srcPtr, NULL);
-            glCompileShader(fs);
+    SpriteData decodeCelSprite(const std::string& path, int32_t firstFrame, int32_t numFrames)
+    {
+        Cel::CelFile cel(path, true);
 
-            glGetShaderiv(fs, GL_COMPILE_STATUS, &isCompiled);
-            if (isCompiled == GL_FALSE)
-            {
-                GLint maxLength = 0;
-                glGetShaderiv(fs, GL_INFO_LOG_LENGTH, &maxLength);
+        if (numFrames < 0)
+            numFrames = cel.numFrames() - firstFrame;
+        debug_assert(firstFrame >= 0 && firstFrame + numFrames <= cel.numFrames());
 
-                // The maxLength includes the NULL character
-                std::vector<GLchar> errorLog(maxLength);
-                glGetShaderInfoLog(fs, maxLength, &maxLength, &errorLog[0]);
+        SpriteData data;
+        data.palette = cel.palette();
+        data.animLength = cel.animLength();
+        data.frames.resize(numFrames);
 
-                std::cout << &errorLog[0] << std::endl;
+        // frames are decoded as they're asked for, so the rest of the file is never touched
+        for (int32_t i = 0; i < numFrames; i++)
+        {
+            const Cel::CelFrame& frame = cel[firstFrame + i];
+            SpriteData::Frame& dest = data.frames[i];
+            dest.width = frame.width();
+            dest.height = frame.height();
+            dest.pixels.resize(frame.width() * frame.height() * 2);
 
-                // Provide the infolog in whatever manor you deem best.
-                // Exit with failure.
-                glDeleteShader(fs); // Don't leak the shader.
-                return;
+            for (int32_t y = 0; y < frame.height(); y++)
+            {
+                for (int32_t x = 0; x < frame.width(); x++)
+                {
+                    const Cel::Colour& c = frame.get(x, y);
+                    dest.pixels[(x + y * frame.width()) * 2 + 0] = c.r;
+                    dest.pixels[(x + y * frame.width()) * 2 + 1] = c.visible ? 255 : 0;
+                }
             }
-
-            shader_programme = glCreateProgram();
-            glAttachShader(shader_programme, fs);
-            glAttachShader(shader_programme, vs);
-            glLinkProgram(shader_programme);
-
-            /*SDL_Surface* surf = SDL_LoadBMP("E:\\tom.bmp");
-
-            SDL_Surface* s = createTransparentSurface(surf->w, surf->h);
-            SDL_BlitSurface(surf, NULL, s, NULL);
-
-            texture = getGLTexFromSurface(s);
-
-            SDL_FreeSurface(s);
-            SDL_FreeSurface(surf);*/
         }
 
-        /*GLint loc = glGetUniformLocation(shader_programme, "width");
-        if (loc != -1)
-        {
-            glUniform1f(loc, WIDTH);
-        }
-        loc = glGetUniformLocation(shader_programme, "height");
-        if (loc != -1)
-        {
-            glUniform1f(loc, HEIGHT);
-        }
+        return data;
+    }
 
-        loc = glGetUniformLocation(shader_programme, "imgW");
-        if (loc != -1)
-        {
-            glUniform1f(loc, 150);
-        }
-        loc = glGetUniformLocation(shader_programme, "imgH");
-        if (loc != -1)
-        {
-            glUniform1f(loc, 100);
-        }
+    SpriteGroup::SpriteGroup(const std::string& path) : SpriteGroup(decodeCelSprite(path)) {}
 
-        loc = glGetUniformLocation(shader_programme, "offsetX");
-        if (loc != -1)
-        {
-            glUniform1f(loc, 150);
-        }
-        loc = glGetUniformLocation(shader_programme, "offsetY");
-        if (loc != -1)
+    namespace
+    {
+        /// Uploads the frames into an atlas sized to fit them, writing their references to dest
+        std::shared_ptr<TextureAtlas> uploadSpriteFrames(const SpriteData& data, TextureReference* dest)
         {
-            glUniform1f(loc, 100);
-        }
-
-        //glClearColor(1.0f, 0.0f, 0.0f, 0.0f);
-        //glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-        glUseProgram(shader_programme);
-        glBindVertexArray(vao);
-        // draw points 0-3 from the currently bound VAO with current in-use shader
-        glDrawArrays(GL_TRIANGLES, 0, 6);*/
-
-        // drawAt(texture, 0, 0);
+            std::vector<int32_t> widths, heights;
+            for (const auto& frame : data.frames)
+            {
+                widths.push_back(frame.width);
+                heights.push_back(frame.height);
+            }
 
-        SDL_GL_SwapWindow(screen);
-        // SDL_RenderPresent(renderer);
-    }
+            int32_t pageWidth, pageHeight;
+            TextureAtlas::fitPageSize(widths, heights, pageWidth, pageHeight);
 
-    void drawSprite(GLuint sprite, int32_t x, int32_t y, boost::optional<Cel::Colour> highlightColor)
-    {
-        glUseProgram(shader_programme);
+            auto atlas = std::make_shared<TextureAtlas>(TextureFormat::IndexAlpha, pageWidth, pageHeight);
+            int32_t palette = addPalette(data.palette);
 
-        auto setUniform = [](const char* name, double value) {
-            GLint loc = glGetUniformLocation(shader_programme, name);
-            if (loc != -1)
+            for (size_t i = 0; i < data.frames.size(); i++)
             {
-                glUniform1f(loc, value);
+                const SpriteData::Frame& frame = data.frames[i];
+                dest[i] = atlas->add(frame.pixels.data(), frame.width, frame.height);
+                dest[i].palette = palette;
             }
-        };
-
-        setUniform("width", WIDTH);
-        setUniform("height", HEIGHT);
-
-        int32_t w, h;
-        spriteSize((Sprite)(intptr_t)sprite, w, h);
 
-        setUniform("imgW", w);
-        setUniform("imgH", h);
-        setUniform("offsetX", x);
-        setUniform("offsetY", y);
-        if (auto c = highlightColor)
-        {
-            setUniform("h_color_r", c->r / 255.f);
-            setUniform("h_color_g", c->g / 255.f);
-            setUniform("h_color_b", c->b / 255.f);
-            setUniform("h_color_a", 1.0f);
+            return atlas;
         }
-        else
-            setUniform("h_color_a", 0.0f);
-
-        glBindTexture(GL_TEXTURE_2D, sprite);
+    }
 
-        glBindVertexArray(vao);
-        // draw points 0-3 from the currently bound VAO with current in-use shader
-        glDrawArrays(GL_TRIANGLES, 0, 6);
+    SpriteGroup::SpriteGroup(const SpriteData& data) : mFrames(data.frames.size()), mAnimLength(data.animLength)
+    {
+        mAtlas = uploadSpriteFrames(data, mFrames.data());
     }
 
-    void handleEvents()
+    void SpriteGroup::setNumDirections(size_t numDirections)
     {
-        SDL_Event event;
-        while (SDL_PollEvent(&event))
-        {
-            // do nothing, just clear the event queue to avoid render window hang up in ubuntu.
-        }
+        debug_assert(!mAtlas && numDirections > 0 && mFrames.size() % numDirections == 0);
+
+        mUnloadedFrames = mFrames;
+        mAnimLength = mFrames.size() / numDirections;
+        mDirections.assign(numDirections, Direction());
     }
 
-    void drawSprite(const Sprite& sprite, int32_t x, int32_t y, boost::optional<Cel::Colour> highlightColor)
+    void SpriteGroup::loadDirection(size_t direction, const SpriteData& data)
     {
-        drawSprite((GLuint)(intptr_t)sprite, x, y, highlightColor);
+        debug_assert(direction < mDirections.size() && data.frames.size() == mAnimLength);
+        mDirections[direction].atlas = uploadSpriteFrames(data, &mFrames[direction * mAnimLength]);
     }
 
-    constexpr auto tileHeight = 32;
-    constexpr auto tileWidth = tileHeight * 2;
+    void SpriteGroup::unloadDirection(size_t direction)
+    {
+        debug_assert(direction < mDirections.size());
 
-    void drawAtTile(const Sprite& sprite, const Misc::Point& tileTop, int spriteW, int spriteH, boost::optional<Cel::Colour> highlightColor = boost::none)
+        std::copy_n(mUnloadedFrames.begin() + direction * mAnimLength, mAnimLength, mFrames.begin() + direction * mAnimLength);
+        mDirections[direction].atlas.reset();
+        mDirections[direction].requested = false;
+    }
+
+    bool SpriteGroup::takeDirectionUsed(size_t direction)
     {
-        // centering spright at the center of tile by width and at the bottom of tile by height
-        drawSprite(sprite, tileTop.x - spriteW / 2, tileTop.y - spriteH + tileHeight, highlightColor);
+        bool used = mDirections[direction].used;
+        mDirections[direction].used = false;
+        return used;
     }
 
-    SpriteGroup::SpriteGroup(const std::string& path)
+    SpriteGroup* createPlaceholderSprite(const std::vector<int32_t>& widths, const std::vector<int32_t>& heights)
     {
-        Cel::CelFile cel(path);
+        debug_assert(widths.size() == heights.size());
 
-        for (int32_t i = 0; i < cel.numFrames(); i++)
+        // One transparent texture big enough for every frame, so it draws correctly through every path (batcher, gui, software)
+        int32_t maxWidth = 1;
+        int32_t maxHeight = 1;
+        for (size_t i = 0; i < widths.size(); i++)
         {
-            SDL_Surface* s = createTransparentSurface(cel[i].width(), cel[i].height());
-            drawFrame(s, 0, 0, cel[i]);
+            maxWidth = std::max(maxWidth, widths[i]);
+            maxHeight = std::max(maxHeight, heights[i]);
+        }
 
-            mSprites.push_back((Render::Sprite)(intptr_t)getGLTexFromSurface(s)); // SDL_CreateTextureFromSurface(renderer, s));
+        std::vector<uint8_t> pixels(maxWidth * maxHeight * 4, 0);
+        uint32_t texture = createTexture(maxWidth, maxHeight, pixels.data());
 
-            SDL_FreeSurface(s);
+        std::vector<TextureReference> frames(widths.size());
+        for (size_t i = 0; i < frames.size(); i++)
+        {
+            frames[i].texture = texture;
+            frames[i].width = widths[i];
+            frames[i].height = heights[i];
+            frames[i].u1 = float(widths[i]) / maxWidth;
+            frames[i].v1 = float(heights[i]) / maxHeight;
         }
-        mWidth = cel[0].width();
-        mHeight = cel[0].height();
 
-        mAnimLength = cel.animLength();
+        return new SpriteGroup(std::move(frames));
     }
 
-    Sprite& SpriteGroup::operator[](size_t index)
+    Sprite SpriteGroup::operator[](size_t index)
     {
-        debug_assert(index < mSprites.size());
-        return mSprites[index];
+        debug_assert(index < mFrames.size());
+
+        if (!mDirections.empty())
+        {
+            Direction& direction = mDirections[index / mAnimLength];
+            direction.used = true;
+
+            if (!direction.atlas && !direction.requested && mDirectionRequestHandler)
+            {
+                direction.requested = true;
+                mDirectionRequestHandler(index / mAnimLength);
+            }
+        }
+
+        return &mFrames[index];
     }
 
     void SpriteGroup::toPng(const std::string& celPath, const std::string& pngPath)
@@ -867,57 +1142,71 @@ namespace Render
 
     void SpriteGroup::destroy()
     {
-        for (size_t i = 0; i < mSprites.size(); i++)
+        if (mAtlas)
         {
-            GLuint tex = (GLuint)(intptr_t)mSprites[i];
-            glDeleteTextures(1, &tex);
+            mAtlas.reset();
+            return;
         }
-    }
 
-    void drawMinPillarTop(SDL_Surface* s, int x, int y, const std::vector<int16_t>& pillar, Cel::CelFile& tileset);
-    void drawMinPillarBase(SDL_Surface* s, int x, int y, const std::vector<int16_t>& pillar, Cel::CelFile& tileset);
+        // the loaded directions' textures go with their atlases, which leaves the ones the group was made with
+        if (!mDirections.empty())
+        {
+            mFrames = mUnloadedFrames;
+            mDirections.clear();
+        }
 
-    SpriteGroup* loadTilesetSprite(const std::string& celPath, const std::string& minPath, bool top)
-    {
-        Cel::CelFile cel(celPath);
-        Level::Min min(minPath);
+        // frames can share a texture (see createPlaceholderSprite)
+        std::vector<uint32_t> textures;
+        for (const auto& frame : mFrames)
+            textures.push_back(frame.texture);
 
-        SDL_Surface* newPillar = createTransparentSurface(64, 256);
+        std::sort(textures.begin(), textures.end());
+        textures.erase(std::unique(textures.begin(), textures.end()), textures.end());
 
-        std::vector<Sprite> newMin(min.size() - 1);
+        for (uint32_t texture : textures)
+            deleteTexture(texture);
+    }
 
-        for (size_t i = 0; i < min.size() - 1; i++)
+    int64_t SpriteGroup::memoryUsage() const
+    {
+        if (mAtlas)
+            return mAtlas->memoryUsage();
+
+        int64_t bytes = 0;
+        if (!mDirections.empty())
         {
-            clearTransparentSurface(newPillar);
+            // the frames of unloaded directions all share one small placeholder texture
+            for (const auto& direction : mDirections)
+                bytes += direction.atlas ? direction.atlas->memoryUsage() : 0;
 
-            if (top)
-                drawMinPillarTop(newPillar, 0, 0, min[i], cel);
-            else
-                drawMinPillarBase(newPillar, 0, 0, min[i], cel);
+            return bytes;
+        }
 
-            newMin[i] = (Sprite)(intptr_t)getGLTexFromSurface(newPillar); // NULL;// SDL_CreateTextureFromSurface(renderer, newPillar);
+        for (const auto& frame : mFrames)
+        {
+            TextureFormat format = frame.palette == -1 ? TextureFormat::RGBA : TextureFormat::IndexAlpha;
+            bytes += int64_t(frame.width) * frame.height * bytesPerPixel(format);
         }
 
-        SDL_FreeSurface(newPillar);
+        return bytes;
+    }
 
-        return new SpriteGroup(newMin);
+    SpriteGroup* loadTilesetSprite(const std::string& celPath, const std::string& minPath, bool top)
+    {
+        return new SpriteGroup(decodeTilesetSprite(celPath, minPath, top));
     }
 
     void spriteSize(const Sprite& sprite, int32_t& w, int32_t& h)
     {
-        GLint tmpW = 0, tmpH = 0;
-
-        glBindTexture(GL_TEXTURE_2D, (GLuint)(intptr_t)sprite);
-
-        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &tmpW);
-        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &tmpH);
-        // SDL_QueryTexture((SDL_Texture*)sprite, NULL, NULL, &tmpW, &tmpH);
-        w = tmpW;
-        h = tmpH;
+        w = sprite->width;
+        h = sprite->height;
     }
 
     void clear(int r, int g, int b)
     {
+        if (headless)
+            return softwareRenderer.clear(r, g, b);
+
         glClearColor(((float)r) / 255.0, ((float)g) / 255.0, ((float)b) / 255.0, 1.0);
         glClear(GL_COLOR_BUFFER_BIT);
     }
@@ -1034,57 +1323,6 @@ namespace Render
         }
     }
 
-    void drawMinTile(SDL_Surface* s, Cel::CelFile& f, int x, int y, int16_t l, int16_t r)
-    {
-        if (l != -1)
-            drawFrame(s, x, y, f[l]);
-
-        if (r != -1)
-            drawFrame(s, x + 32, y, f[r]);
-    }
-
-    void drawMinPillar(SDL_Surface* s, int x, int y, const std::vector<int16_t>& pillar, Cel::CelFile& tileset, bool top)
-    {
-        // compensate for maps using 5-row min files
-        if (pillar.size() == 10)
-            y += 3 * 32;
-
-        size_t i, lim;
-
-        if (top)
-        {
-            i = 0;
-            lim = pillar.size() - 2;
-        }
-        else
-        {
-            i = pillar.size() - 2;
-            lim = pillar.size();
-            y += i * 16;
-        }
-
-        // Each iteration draw one row of the min
-        for (; i < lim; i += 2)
-        {
-            int16_t l = (pillar[i] & 0x0FFF) - 1;
-            int16_t r = (pillar[i + 1] & 0x0FFF) - 1;
-
-            drawMinTile(s, tileset, x, y, l, r);
-
-            y += 32; // down 32 each row
-        }
-    }
-
-    void drawMinPillarTop(SDL_Surface* s, int x, int y, const std::vector<int16_t>& pillar, Cel::CelFile& tileset)
-    {
-        drawMinPillar(s, x, y, pillar, tileset, true);
-    }
-
-    void drawMinPillarBase(SDL_Surface* s, int x, int y, const std::vector<int16_t>& pillar, Cel::CelFile& tileset)
-    {
-        drawMinPillar(s, x, y, pillar, tileset, false);
-    }
-
     // basic transform of isometric grid to normal, (0, 0) tile coordinate maps to (0, 0) pixel coordinates
     // since eventually we're gonna shift coordinates to viewport center, it's better to keep transform itself
     // as simple as possible
@@ -1106,11 +1344,9 @@ namespace Render
                                  const Misc::Point& toScreen,
                                  boost::optional<Cel::Colour> highlightColor = boost::none)
     {
-        int32_t w, h;
-        spriteSize(sprite, w, h);
         auto point = tileTopPoint(pos) + tileTopPoint(fractionalPos) / 100;
         auto res = point + toScreen;
-        drawAtTile(sprite, res, w, h, highlightColor);
+        drawAtTile(sprite, res, sprite->width, sprite->height, highlightColor);
     }
 
     constexpr auto bottomMenuSize = 144; // TODO: pass it as a variable
@@ -1129,7 +1365,10 @@ namespace Render
 
     constexpr auto staticObjectHeight = 256;
 
-    template <typename ProcessTileFunc> void drawObjectsByTiles(const Misc::Point& toScreen, ProcessTileFunc processTile)
+    /// Calls processTile for each tile on screen, back to front. Tiles inside (0, 0) - skipSize are stepped over without
+    /// being visited, so passing the level size visits only the tiles off the edge of the map.
+    template <typename ProcessTileFunc>
+    void drawObjectsByTiles(const Misc::Point& toScreen, ProcessTileFunc processTile, const Misc::Point& skipSize = Misc::Point(0, 0))
     {
         Misc::Point start{-2 * tileWidth, -2 * tileHeight};
         auto startingTile = getTileFromScreenCoords(start, toScreen);
@@ -1144,6 +1383,17 @@ namespace Render
                 point.x += tileWidth;
                 ++tile.pos.x;
                 --tile.pos.y;
+
+                if (tile.pos.x >= 0 && tile.pos.y >= 0 && tile.pos.x < skipSize.x && tile.pos.y < skipSize.y)
+                {
+                    // x only goes up and y only goes down along a line, so the skipped tiles are one run
+                    int32_t run = std::min(skipSize.x - 1 - tile.pos.x, tile.pos.y);
+                    tile.pos.x += run;
+                    tile.pos.y -= run;
+                    point.x += run * tileWidth;
+                    continue;
+                }
+
                 processTile(tile, point);
             }
         };
@@ -1162,6 +1412,142 @@ namespace Render
         }
     }
 
+    // The floor layer only changes when the level does, so it is built into static batches, one per chunk of
+    // levelChunkSize x levelChunkSize tiles, in world pixel coordinates. Each frame the visible chunks are drawn at the
+    // current camera offset, without walking the tiles at all. Floor pillars never overlap each other (apart from
+    // their transparent parts), so the quads can be reordered by texture within a chunk.
+    // When the level changes (eg. a door opens) only the chunks with a changed tile are rebuilt.
+    constexpr int32_t levelChunkSize = 16;
+
+    struct FloorChunk
+    {
+        StaticSpriteBatch batch;
+        Misc::Point min;
+        Misc::Point max;
+    };
+
+    struct FloorCache
+    {
+        int32_t levelVersion = -1;
+        size_t minBottomsHandle = 0;
+        SpriteGroup* minBottoms = nullptr; ///< pinned in the sprite cache while we hold references to its frames
+        Misc::Point levelSize;
+        std::vector<size_t> tileIndices; ///< what each tile was built from, to find the chunks that are out of date
+        std::vector<FloorChunk> chunks;  ///< row major, chunksWide() per row
+
+        int32_t chunksWide() const { return (levelSize.x + levelChunkSize - 1) / levelChunkSize; }
+
+        void clear()
+        {
+            for (auto& chunk : chunks)
+                chunk.batch.clear();
+            chunks.clear();
+            tileIndices.clear();
+            minBottoms = nullptr;
+        }
+    };
+
+    FloorCache floorCache;
+
+    static void clearFloorCache() { floorCache.clear(); }
+
+    static void updateFloorCache(const Level::Level& level, size_t minBottomsHandle, SpriteCacheBase* cache)
+    {
+        SpriteGroup* minBottoms = cache->get(minBottomsHandle);
+        if (floorCache.minBottoms == minBottoms && floorCache.levelVersion == level.version())
+            return;
+
+        Misc::Point levelSize(level.width(), level.height());
+        std::vector<size_t> tileIndices(levelSize.x * levelSize.y);
+        for (int32_t y = 0; y < levelSize.y; y++)
+            for (int32_t x = 0; x < levelSize.x; x++)
+                tileIndices[x + y * levelSize.x] = level.get(Misc::Point(x, y)).index();
+
+        std::vector<bool> dirty;
+        if (floorCache.minBottoms == minBottoms && floorCache.levelSize == levelSize)
+        {
+            dirty.resize(floorCache.chunks.size(), false);
+            for (int32_t y = 0; y < levelSize.y; y++)
+                for (int32_t x = 0; x < levelSize.x; x++)
+                    if (tileIndices[x + y * levelSize.x] != floorCache.tileIndices[x + y * levelSize.x])
+                        dirty[x / levelChunkSize + (y / levelChunkSize) * floorCache.chunksWide()] = true;
+        }
+        else
+        {
+            if (floorCache.minBottoms && floorCache.minBottomsHandle != minBottomsHandle)
+                cache->setImmortal(floorCache.minBottomsHandle, false);
+            cache->setImmortal(minBottomsHandle, true);
+
+            floorCache.clear();
+            floorCache.minBottomsHandle = minBottomsHandle;
+            floorCache.minBottoms = minBottoms;
+            floorCache.levelSize = levelSize;
+            floorCache.chunks.resize(floorCache.chunksWide() * ((levelSize.y + levelChunkSize - 1) / levelChunkSize));
+            dirty.resize(floorCache.chunks.size(), true);
+        }
+
+        floorCache.levelVersion = level.version();
+        floorCache.tileIndices = std::move(tileIndices);
+
+        for (size_t i = 0; i < floorCache.chunks.size(); i++)
+        {
+            if (!dirty[i])
+                continue;
+
+            FloorChunk& chunk = floorCache.chunks[i];
+            chunk.batch.clear();
+            chunk.min = Misc::Point(INT32_MAX, INT32_MAX);
+            chunk.max = Misc::Point(INT32_MIN, INT32_MIN);
+
+            int32_t chunkX = (i % floorCache.chunksWide()) * levelChunkSize;
+            int32_t chunkY = (i / floorCache.chunksWide()) * levelChunkSize;
+
+            for (int32_t y = chunkY; y < std::min(chunkY + levelChunkSize, levelSize.y); y++)
+            {
+                for (int32_t x = chunkX; x < std::min(chunkX + levelChunkSize, levelSize.x); x++)
+                {
+                    size_t index = floorCache.tileIndices[x + y * levelSize.x];
+                    if (index >= minBottoms->size())
+                        continue;
+
+                    // same placement as drawAtTile
+                    Misc::Point tileTop = tileTopPoint(Tile(x, y));
+                    int32_t left = tileTop.x - tileWidth / 2;
+                    int32_t top = tileTop.y - staticObjectHeight + tileHeight;
+                    chunk.batch.add((*minBottoms)[index], left, top);
+
+                    chunk.min = Misc::Point(std::min(chunk.min.x, left), std::min(chunk.min.y, top));
+                    chunk.max = Misc::Point(std::max(chunk.max.x, left + tileWidth), std::max(chunk.max.y, top + staticObjectHeight));
+                }
+            }
+
+            if (!headless && !chunk.batch.quads().empty())
+                spriteBatcher.upload(chunk.batch);
+        }
+    }
+
+    static void drawFloor(const Misc::Point& toScreen)
+    {
+        for (const auto& chunk : floorCache.chunks)
+        {
+            if (chunk.batch.quads().empty())
+                continue;
+
+            if (chunk.max.x + toScreen.x <= 0 || chunk.max.y + toScreen.y <= 0 || chunk.min.x + toScreen.x >= WIDTH || chunk.min.y + toScreen.y >= HEIGHT)
+                continue;
+
+            if (headless)
+            {
+                for (const auto& quad : chunk.batch.quads())
+                    softwareRenderer.drawSprite(*quad.sprite, quad.x + toScreen.x, quad.y + toScreen.y, boost::none);
+            }
+            else
+            {
+                spriteBatcher.drawStatic(chunk.batch, toScreen.x, toScreen.y);
+            }
+        }
+    }
+
     void drawLevel(const Level::Level& level,
                    size_t minTopsHandle,
                    size_t minBottomsHandle,
@@ -1174,23 +1560,20 @@ namespace Render
                    const Misc::Point& fractionalPos)
     {
         auto toScreen = worldToScreenVector(pos, fractionalPos);
-        SpriteGroup* minBottoms = cache->get(minBottomsHandle);
         auto isInvalidTile = [&](const Tile& tile) {
             return tile.pos.x < 0 || tile.pos.y < 0 || tile.pos.x >= static_cast<int32_t>(level.width()) || tile.pos.y >= static_cast<int32_t>(level.height());
         };
 
         // drawing on the ground objects
-        drawObjectsByTiles(toScreen, [&](const Tile& tile, const Misc::Point& topLeft) {
-            if (isInvalidTile(tile))
-            {
-                // For some reason this code stopped working so for now out of map tiles should be black
-                return drawAtTile((*minBottoms)[0], topLeft, tileWidth, staticObjectHeight);
-            }
+        updateFloorCache(level, minBottomsHandle, cache);
+        drawFloor(toScreen);
 
-            size_t index = level.get(tile.pos).index();
-            if (index < minBottoms->size())
-                drawAtTile((*minBottoms)[index], topLeft, tileWidth, staticObjectHeight); // all static objects have the same sprite size
-        });
+        // For some reason this code stopped working so for now out of map tiles should be black
+        SpriteGroup* minBottoms = floorCache.minBottoms;
+        drawObjectsByTiles(
+            toScreen,
+            [&](const Tile&, const Misc::Point& topLeft) { drawAtTile((*minBottoms)[0], topLeft, tileWidth, staticObjectHeight); },
+            floorCache.levelSize);
 
         SpriteGroup* minTops = cache->get(minTopsHandle);
         cache->setImmortal(minTopsHandle, true);
@@ -1210,20 +1593,18 @@ namespace Render
                 {
                     int32_t specialSpriteIndex = specialSpritesMap.at(index);
                     SpriteGroup* specialSpriteGroup = cache->get(specialSpritesHandle);
-                    Sprite& sprite = (*specialSpriteGroup)[specialSpriteIndex];
-                    int w, h;
-                    spriteSize(sprite, w, h);
-                    drawAtTile(sprite, topLeft, w, h);
+                    drawAtTile((*specialSpriteGroup)[specialSpriteIndex],
+                               topLeft,
+                               specialSpriteGroup->getWidth(specialSpriteIndex),
+                               specialSpriteGroup->getHeight(specialSpriteIndex));
                 }
             }
 
             auto& itemsForTile = items.get(tile.pos.x, tile.pos.y);
             for (auto& item : itemsForTile)
             {
-                int32_t w, h;
-                auto sprite = (*cache->get(item.spriteCacheIndex))[item.spriteFrame];
-                spriteSize(sprite, w, h);
-                drawAtTile(sprite, topLeft, w, h, item.hoverColor);
+                SpriteGroup* sprite = cache->get(item.spriteCacheIndex);
+                drawAtTile((*sprite)[item.spriteFrame], topLeft, sprite->getWidth(item.spriteFrame), sprite->getHeight(item.spriteFrame), item.hoverColor);
             }
 
             auto& objsForTile = objs.get(tile.pos.x, tile.pos.y);
@@ -7,6 +7,7 @@ PFNGLBINDBUFFERPROC glBindBuffer;
 PFNGLBUFFERDATAPROC glBufferData;
 PFNGLGENVERTEXARRAYSPROC glGenVertexArrays;
 PFNGLBINDVERTEXARRAYPROC glBindVertexArray;
+PFNGLDELETEVERTEXARRAYSPROC glDeleteVertexArrays;
 PFNGLENABLEVERTEXATTRIBARRAYPROC glEnableVertexAttribArray;
 PFNGLVERTEXATTRIBPOINTERPROC glVertexAttribPointer;
 PFNGLCREATESHADERPROC glCreateShader;
@@ -21,6 +22,8 @@ PFNGLGETSHADERINFOLOGPROC glGetShaderInfoLog;
 PFNGLDELETESHADERPROC glDeleteShader;
 PFNGLGETUNIFORMLOCATIONPROC glGetUniformLocation;
 PFNGLUNIFORM1FPROC glUniform1f;
+PFNGLUNIFORM2FPROC glUniform2f;
+PFNGLUNIFORM4FPROC glUniform4f;
 PFNGLGETPROGRAMIVPROC glGetProgramiv;
 PFNGLGETATTRIBLOCATIONPROC glGetAttribLocation;
 PFNGLDETACHSHADERPROC glDetachShader;
@@ -47,6 +50,8 @@ void initGlFuncs()
     memcpy(&glGenVertexArrays, &tmp, sizeof(void*));
     tmp = SDL_GL_GetProcAddress("glBindVertexArray");
     memcpy(&glBindVertexArray, &tmp, sizeof(void*));
+    tmp = SDL_GL_GetProcAddress("glDeleteVertexArrays");
+    memcpy(&glDeleteVertexArrays, &tmp, sizeof(void*));
     tmp = SDL_GL_GetProcAddress("glEnableVertexAttribArray");
     memcpy(&glEnableVertexAttribArray, &tmp, sizeof(void*));
     tmp = SDL_GL_GetProcAddress("glVertexAttribPointer");
@@ -75,6 +80,10 @@ void initGlFuncs()
     memcpy(&glGetUniformLocation, &tmp, sizeof(void*));
     tmp = SDL_GL_GetProcAddress("glUniform1f");
     memcpy(&glUniform1f, &tmp, sizeof(void*));
+    tmp = SDL_GL_GetProcAddress("glUniform2f");
+    memcpy(&glUniform2f, &tmp, sizeof(void*));
+    tmp = SDL_GL_GetProcAddress("glUniform4f");
+    memcpy(&glUniform4f, &tmp, sizeof(void*));
     tmp = SDL_GL_GetProcAddress("glGetProgramiv");
     memcpy(&glGetProgramiv, &tmp, sizeof(void*));
     tmp = SDL_GL_GetProcAddress("glGetAttribLocation");
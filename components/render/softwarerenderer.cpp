@@ -0,0 +1,329 @@
+#include "softwarerenderer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "../../apps/freeablo/fagui/guimanager.h"
+#include "nuklear_sdl_gl3.h"
+#include <misc/assert.h>
+
+namespace Render
+{
+    void SoftwareRenderer::resize(int32_t width, int32_t height)
+    {
+        mWidth = width;
+        mHeight = height;
+        mFramebuffer.assign(mWidth * mHeight * 4, 0);
+    }
+
+    uint32_t SoftwareRenderer::createTexture(int32_t width, int32_t height, const uint8_t* pixels, TextureFormat format)
+    {
+        uint32_t name;
+        if (mFreeTextures.empty())
+        {
+            mTextures.emplace_back();
+            name = mTextures.size();
+        }
+        else
+        {
+            name = mFreeTextures.back();
+            mFreeTextures.pop_back();
+        }
+
+        Texture& texture = getTexture(name);
+        texture.width = width;
+        texture.height = height;
+        texture.format = format;
+        texture.pixels.assign(width * height * bytesPerPixel(format), 0);
+
+        if (pixels)
+            memcpy(texture.pixels.data(), pixels, texture.pixels.size());
+
+        return name;
+    }
+
+    void SoftwareRenderer::updateTexture(uint32_t texture, int32_t x, int32_t y, int32_t width, int32_t height, const uint8_t* pixels)
+    {
+        Texture& tex = getTexture(texture);
+        debug_assert(x >= 0 && y >= 0 && x + width <= tex.width && y + height <= tex.height);
+
+        int32_t bpp = bytesPerPixel(tex.format);
+        for (int32_t row = 0; row < height; row++)
+            memcpy(&tex.pixels[(x + (y + row) * tex.width) * bpp], pixels + row * width * bpp, width * bpp);
+    }
+
+    void SoftwareRenderer::deleteTexture(uint32_t texture)
+    {
+        Texture& tex = getTexture(texture);
+        tex.pixels = std::vector<uint8_t>();
+        tex.width = tex.height = 0;
+        mFreeTextures.push_back(texture);
+    }
+
+    SoftwareRenderer::Texture& SoftwareRenderer::getTexture(uint32_t texture)
+    {
+        debug_assert(texture > 0 && texture <= mTextures.size());
+        return mTextures[texture - 1];
+    }
+
+    void SoftwareRenderer::setPalette(int32_t palette, const uint8_t* rgba)
+    {
+        debug_assert(palette >= 0 && palette < MAX_PALETTES);
+
+        if (mPalettes.empty())
+            mPalettes.resize(MAX_PALETTES * 256 * 4);
+
+        memcpy(&mPalettes[palette * 256 * 4], rgba, 256 * 4);
+    }
+
+    const uint8_t* SoftwareRenderer::getPalette(int32_t palette) const
+    {
+        if (palette < 0)
+            return nullptr;
+
+        debug_assert(!mPalettes.empty() && palette < MAX_PALETTES);
+        return &mPalettes[palette * 256 * 4];
+    }
+
+    SoftwareRenderer::Rgba SoftwareRenderer::texel(const Texture& texture, const uint8_t* palette, int32_t x, int32_t y)
+    {
+        const uint8_t* src = texture.get(x, y);
+
+        if (texture.format == TextureFormat::IndexAlpha)
+        {
+            const uint8_t* colour = palette + src[0] * 4;
+            return Rgba{colour[0], colour[1], colour[2], src[1]};
+        }
+
+        return Rgba{src[0], src[1], src[2], src[3]};
+    }
+
+    void SoftwareRenderer::clear(uint8_t r, uint8_t g, uint8_t b)
+    {
+        for (size_t i = 0; i < mFramebuffer.size(); i += 4)
+        {
+            mFramebuffer[i + 0] = r;
+            mFramebuffer[i + 1] = g;
+            mFramebuffer[i + 2] = b;
+            mFramebuffer[i + 3] = 255;
+        }
+    }
+
+    void SoftwareRenderer::blend(int32_t x, int32_t y, uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+    {
+        if (a == 0)
+            return;
+
+        uint8_t* dst = &mFramebuffer[(x + y * mWidth) * 4];
+
+        if (a == 255)
+        {
+            dst[0] = r;
+            dst[1] = g;
+            dst[2] = b;
+            return;
+        }
+
+        int32_t inv = 255 - a;
+        dst[0] = static_cast<uint8_t>((r * a + dst[0] * inv + 127) / 255);
+        dst[1] = static_cast<uint8_t>((g * a + dst[1] * inv + 127) / 255);
+        dst[2] = static_cast<uint8_t>((b * a + dst[2] * inv + 127) / 255);
+    }
+
+    // Same test as the outline loop in basic.frag
+    bool SoftwareRenderer::shouldHighlight(const Texture& texture, const uint8_t* palette, int32_t x, int32_t y)
+    {
+        for (int32_t j = -1; j <= 1; j++)
+        {
+            for (int32_t i = -1; i <= 1; i++)
+            {
+                int32_t nx = x + i;
+                int32_t ny = y + j;
+                if (nx < 0 || ny < 0 || nx >= texture.width || ny >= texture.height)
+                    continue;
+
+                Rgba n = texel(texture, palette, nx, ny);
+                if (n.a > 0 && (n.r > 0 || n.g > 0 || n.b > 0))
+                    return true;
+            }
+        }
+
+        return false;
+    }
+
+    void SoftwareRenderer::drawSprite(const TextureReference& sprite, int32_t x, int32_t y, const boost::optional<Cel::Colour>& highlightColor)
+    {
+        int32_t startX = std::max(0, -x);
+        int32_t startY = std::max(0, -y);
+        int32_t endX = std::min(sprite.width, mWidth - x);
+        int32_t endY = std::min(sprite.height, mHeight - y);
+
+        if (startX >= endX || startY >= endY)
+            return;
+
+        const Texture& texture = getTexture(sprite.texture);
+        const uint8_t* palette = getPalette(sprite.palette);
+
+        for (int32_t sy = startY; sy < endY; sy++)
+        {
+            for (int32_t sx = startX; sx < endX; sx++)
+            {
+                int32_t tx = sprite.x + sx;
+                int32_t ty = sprite.y + sy;
+                Rgba src = texel(texture, palette, tx, ty);
+
+                if (src.a == 0 && highlightColor && shouldHighlight(texture, palette, tx, ty))
+                    blend(x + sx, y + sy, highlightColor->r, highlightColor->g, highlightColor->b, 255);
+                else
+                    blend(x + sx, y + sy, src.r, src.g, src.b, src.a);
+            }
+        }
+
+        mDrawCalls++;
+        mVertices += 4;
+    }
+
+    void SoftwareRenderer::drawGui(NuklearFrameDump& dump, SpriteCacheBase* cache)
+    {
+        const nk_sdl_vertex* vertices = static_cast<const nk_sdl_vertex*>(dump.vbuf.memory.ptr);
+        const nk_draw_index* indices = static_cast<const nk_draw_index*>(dump.ebuf.memory.ptr);
+
+        auto toGuiVertex = [&](nk_draw_index index) {
+            const nk_sdl_vertex& src = vertices[index];
+            GuiVertex v;
+            v.x = src.position[0];
+            v.y = src.position[1];
+            v.u = src.uv[0];
+            v.v = src.uv[1];
+            for (int32_t i = 0; i < 4; i++)
+                v.colour[i] = src.col[i] / 255.0f;
+            return v;
+        };
+
+        size_t offset = 0;
+        for (const auto& cmd : dump.drawCommands)
+        {
+            if (!cmd.elem_count)
+                continue;
+
+            uint32_t cacheIndex = ((uint32_t*)cmd.texture.ptr)[0];
+            uint32_t frameNum = ((uint32_t*)cmd.texture.ptr)[1];
+            auto effect = static_cast<FAGui::EffectType>(cmd.userdata.id);
+
+            GuiDrawParams params;
+            params.sprite = (*cache->get(cacheIndex))[frameNum];
+            params.texture = &getTexture(params.sprite->texture);
+            params.palette = getPalette(params.sprite->palette);
+            params.highlighted = effect == FAGui::EffectType::highlighted;
+            params.checkerboarded = effect == FAGui::EffectType::checkerboarded;
+            params.clip.left = std::max(0, static_cast<int32_t>(cmd.clip_rect.x));
+            params.clip.top = std::max(0, static_cast<int32_t>(cmd.clip_rect.y));
+            params.clip.right = std::min(mWidth, static_cast<int32_t>(cmd.clip_rect.x + cmd.clip_rect.w));
+            params.clip.bottom = std::min(mHeight, static_cast<int32_t>(cmd.clip_rect.y + cmd.clip_rect.h));
+
+            if (params.clip.left < params.clip.right && params.clip.top < params.clip.bottom)
+            {
+                for (size_t i = offset; i + 2 < offset + cmd.elem_count; i += 3)
+                    drawGuiTriangle(toGuiVertex(indices[i]), toGuiVertex(indices[i + 1]), toGuiVertex(indices[i + 2]), params);
+            }
+
+            offset += cmd.elem_count;
+
+            mDrawCalls++;
+            mVertices += cmd.elem_count;
+        }
+    }
+
+    void SoftwareRenderer::drawGuiTriangle(GuiVertex v0, GuiVertex v1, GuiVertex v2, const GuiDrawParams& params)
+    {
+        auto edge = [](const GuiVertex& a, const GuiVertex& b, float px, float py) { return (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x); };
+
+        float area = edge(v0, v1, v2.x, v2.y);
+        if (area == 0.0f)
+            return;
+
+        if (area < 0.0f)
+        {
+            std::swap(v1, v2);
+            area = -area;
+        }
+
+        // Pixel centres lying exactly on an edge shared by two triangles must only be drawn by one of them,
+        // otherwise translucent quads get a visible diagonal seam. Two triangles always walk a shared edge
+        // in opposite directions, so claiming edges by direction gives each of them to exactly one triangle.
+        auto ownsEdge = [](const GuiVertex& a, const GuiVertex& b) { return b.y > a.y || (b.y == a.y && b.x < a.x); };
+        bool owns0 = ownsEdge(v1, v2);
+        bool owns1 = ownsEdge(v2, v0);
+        bool owns2 = ownsEdge(v0, v1);
+
+        int32_t minX = std::max(params.clip.left, static_cast<int32_t>(std::floor(std::min({v0.x, v1.x, v2.x}))));
+        int32_t minY = std::max(params.clip.top, static_cast<int32_t>(std::floor(std::min({v0.y, v1.y, v2.y}))));
+        int32_t maxX = std::min(params.clip.right, static_cast<int32_t>(std::ceil(std::max({v0.x, v1.x, v2.x}))));
+        int32_t maxY = std::min(params.clip.bottom, static_cast<int32_t>(std::ceil(std::max({v0.y, v1.y, v2.y}))));
+
+        const TextureReference& sprite = *params.sprite;
+        const Texture& texture = *params.texture;
+
+        for (int32_t y = minY; y < maxY; y++)
+        {
+            for (int32_t x = minX; x < maxX; x++)
+            {
+                float px = x + 0.5f;
+                float py = y + 0.5f;
+
+                float w0 = edge(v1, v2, px, py);
+                float w1 = edge(v2, v0, px, py);
+                float w2 = edge(v0, v1, px, py);
+
+                if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f)
+                    continue;
+                if ((w0 == 0.0f && !owns0) || (w1 == 0.0f && !owns1) || (w2 == 0.0f && !owns2))
+                    continue;
+
+                w0 /= area;
+                w1 /= area;
+                w2 /= area;
+
+                float u = w0 * v0.u + w1 * v1.u + w2 * v2.u;
+                float v = w0 * v0.v + w1 * v1.v + w2 * v2.v;
+
+                int32_t spriteX = std::min(std::max(static_cast<int32_t>(std::floor(u * sprite.width)), 0), sprite.width - 1);
+                int32_t spriteY = std::min(std::max(static_cast<int32_t>(std::floor(v * sprite.height)), 0), sprite.height - 1);
+
+                int32_t tx = sprite.x + spriteX;
+                int32_t ty = sprite.y + spriteY;
+                Rgba t = texel(texture, params.palette, tx, ty);
+                uint8_t texelColour[4] = {t.r, t.g, t.b, t.a};
+
+                float colour[4];
+                for (int32_t i = 0; i < 4; i++)
+                    colour[i] = (w0 * v0.colour[i] + w1 * v1.colour[i] + w2 * v2.colour[i]) * texelColour[i];
+
+                if (colour[3] == 0.0f && params.highlighted && shouldHighlight(texture, params.palette, tx, ty))
+                {
+                    colour[0] = 0xB9;
+                    colour[1] = 0xAA;
+                    colour[2] = 0x77;
+                    colour[3] = 255.0f;
+                }
+
+                if (params.checkerboarded && (spriteX + spriteY) % 2 == 1)
+                    continue;
+
+                blend(x,
+                      y,
+                      static_cast<uint8_t>(colour[0] + 0.5f),
+                      static_cast<uint8_t>(colour[1] + 0.5f),
+                      static_cast<uint8_t>(colour[2] + 0.5f),
+                      static_cast<uint8_t>(colour[3] + 0.5f));
+            }
+        }
+    }
+
+    void SoftwareRenderer::resetStats()
+    {
+        mDrawCalls = 0;
+        mVertices = 0;
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include "../cel/pal.h"
+#include "misc.h"
+#include "texture.h"
+
+class NuklearFrameDump;
+
+namespace Render
+{
+    /// Draws into a framebuffer in system memory instead of through OpenGL, so rendering can run (and be
+    /// benchmarked) on machines without a GPU or a display. Textures are kept as plain RGBA pixel buffers,
+    /// and sprites are always drawn unscaled, so drawing them is just a blit.
+    class SoftwareRenderer
+    {
+    public:
+        void resize(int32_t width, int32_t height);
+
+        uint32_t createTexture(int32_t width, int32_t height, const uint8_t* pixels, TextureFormat format);
+        void updateTexture(uint32_t texture, int32_t x, int32_t y, int32_t width, int32_t height, const uint8_t* pixels);
+        void deleteTexture(uint32_t texture);
+        void setPalette(int32_t palette, const uint8_t* rgba); ///< 256 RGBA entries
+
+        void clear(uint8_t r, uint8_t g, uint8_t b);
+        void drawSprite(const TextureReference& sprite, int32_t x, int32_t y, const boost::optional<Cel::Colour>& highlightColor);
+        void drawGui(NuklearFrameDump& dump, SpriteCacheBase* cache);
+
+        int32_t width() const { return mWidth; }
+        int32_t height() const { return mHeight; }
+        const uint8_t* pixels() const { return mFramebuffer.data(); } ///< RGBA, top row first
+
+        uint32_t drawCalls() const { return mDrawCalls; }
+        uint32_t vertices() const { return mVertices; }
+        void resetStats();
+
+    private:
+        struct Texture
+        {
+            int32_t width = 0;
+            int32_t height = 0;
+            TextureFormat format = TextureFormat::RGBA;
+            std::vector<uint8_t> pixels;
+
+            const uint8_t* get(int32_t x, int32_t y) const { return &pixels[(x + y * width) * bytesPerPixel(format)]; }
+        };
+
+        struct Rgba
+        {
+            uint8_t r, g, b, a;
+        };
+
+        struct GuiVertex
+        {
+            float x, y;
+            float u, v;
+            float colour[4];
+        };
+
+        struct GuiClipRect
+        {
+            int32_t left, top, right, bottom;
+        };
+
+        struct GuiDrawParams
+        {
+            const Texture* texture;
+            const TextureReference* sprite;
+            const uint8_t* palette;
+            bool highlighted;
+            bool checkerboarded;
+            GuiClipRect clip;
+        };
+
+        Texture& getTexture(uint32_t texture);
+        const uint8_t* getPalette(int32_t palette) const;
+        static Rgba texel(const Texture& texture, const uint8_t* palette, int32_t x, int32_t y);
+        static bool shouldHighlight(const Texture& texture, const uint8_t* palette, int32_t x, int32_t y);
+        void blend(int32_t x, int32_t y, uint8_t r, uint8_t g, uint8_t b, uint8_t a);
+        void drawGuiTriangle(GuiVertex v0, GuiVertex v1, GuiVertex v2, const GuiDrawParams& params);
+
+        std::vector<Texture> mTextures; ///< texture name n is stored at index n - 1
+        std::vector<uint32_t> mFreeTextures;
+        std::vector<uint8_t> mPalettes; ///< MAX_PALETTES rows of 256 RGBA entries
+
+        std::vector<uint8_t> mFramebuffer;
+        int32_t mWidth = 0;
+        int32_t mHeight = 0;
+
+        uint32_t mDrawCalls = 0;
+        uint32_t mVertices = 0;
+    };
+}
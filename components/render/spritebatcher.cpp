@@ -0,0 +1,276 @@
+#include "spritebatcher.h"
+
+#include "render.h"
+
+#include <misc/assert.h>
+
+#include <algorithm>
+#include <cstddef>
+
+namespace Render
+{
+    constexpr uint32_t SpriteBatcher::MAX_QUADS;
+
+    void StaticSpriteBatch::clear()
+    {
+        if (mVbo)
+        {
+            glDeleteBuffers(1, &mVbo);
+            glDeleteVertexArrays(1, &mVao);
+            mVbo = mVao = 0;
+        }
+
+        mQuads.clear();
+        mRuns.clear();
+    }
+
+    void SpriteBatcher::init(GLuint program)
+    {
+        mProgram = program;
+
+        mUniformWidth = glGetUniformLocation(mProgram, "width");
+        mUniformHeight = glGetUniformLocation(mProgram, "height");
+        mUniformOffset = glGetUniformLocation(mProgram, "offset");
+
+        glUseProgram(mProgram);
+        glUniform1i(glGetUniformLocation(mProgram, "tex"), 0);
+        glUniform1i(glGetUniformLocation(mProgram, "palette_tex"), 1);
+        glUseProgram(0);
+
+        mAttribPos = glGetAttribLocation(mProgram, "vertex_position");
+        mAttribUv = glGetAttribLocation(mProgram, "v_uv");
+        mAttribPalette = glGetAttribLocation(mProgram, "v_palette");
+        mAttribHighlight = glGetAttribLocation(mProgram, "v_highlight_color");
+
+        // Every quad is two triangles over four vertices, so the index buffer never changes
+        std::vector<uint16_t> indices(MAX_QUADS * 6);
+        for (uint32_t i = 0; i < MAX_QUADS; i++)
+        {
+            uint16_t base = static_cast<uint16_t>(i * 4);
+            indices[i * 6 + 0] = base + 0;
+            indices[i * 6 + 1] = base + 1;
+            indices[i * 6 + 2] = base + 2;
+            indices[i * 6 + 3] = base + 0;
+            indices[i * 6 + 4] = base + 2;
+            indices[i * 6 + 5] = base + 3;
+        }
+
+        glGenVertexArrays(1, &mVao);
+        glGenBuffers(1, &mVbo);
+        glGenBuffers(1, &mEbo);
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEbo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint16_t), indices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+        setupVertexArray(mVao, mVbo);
+
+        mVertexData.reserve(MAX_QUADS * 4);
+    }
+
+    void SpriteBatcher::setupVertexArray(GLuint vao, GLuint vbo)
+    {
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEbo);
+
+        GLsizei stride = sizeof(Vertex);
+        glEnableVertexAttribArray((GLuint)mAttribPos);
+        glEnableVertexAttribArray((GLuint)mAttribUv);
+        glEnableVertexAttribArray((GLuint)mAttribPalette);
+        glEnableVertexAttribArray((GLuint)mAttribHighlight);
+        glVertexAttribPointer((GLuint)mAttribPos, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, x));
+        glVertexAttribPointer((GLuint)mAttribUv, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, u));
+        glVertexAttribPointer((GLuint)mAttribPalette, 1, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, palette));
+        glVertexAttribPointer((GLuint)mAttribHighlight, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offsetof(Vertex, highlight));
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+
+    void SpriteBatcher::destroy()
+    {
+        glDeleteBuffers(1, &mVbo);
+        glDeleteBuffers(1, &mEbo);
+        glDeleteVertexArrays(1, &mVao);
+        mVbo = mEbo = mVao = 0;
+    }
+
+    void SpriteBatcher::pushQuad(std::vector<Vertex>& vertices,
+                                 int32_t palette,
+                                 int32_t x,
+                                 int32_t y,
+                                 int32_t w,
+                                 int32_t h,
+                                 float u0,
+                                 float v0,
+                                 float u1,
+                                 float v1,
+                                 const boost::optional<Cel::Colour>& highlightColor)
+    {
+        uint8_t r = 0, g = 0, b = 0, a = 0;
+        if (highlightColor)
+        {
+            r = highlightColor->r;
+            g = highlightColor->g;
+            b = highlightColor->b;
+            a = 255;
+        }
+
+        float left = static_cast<float>(x);
+        float top = static_cast<float>(y);
+        float right = static_cast<float>(x + w);
+        float bottom = static_cast<float>(y + h);
+        float pal = static_cast<float>(palette);
+
+        vertices.push_back(Vertex{left, top, u0, v0, pal, {r, g, b, a}});
+        vertices.push_back(Vertex{right, top, u1, v0, pal, {r, g, b, a}});
+        vertices.push_back(Vertex{right, bottom, u1, v1, pal, {r, g, b, a}});
+        vertices.push_back(Vertex{left, bottom, u0, v1, pal, {r, g, b, a}});
+    }
+
+    void SpriteBatcher::draw(GLuint texture,
+                             int32_t palette,
+                             int32_t x,
+                             int32_t y,
+                             int32_t w,
+                             int32_t h,
+                             float u0,
+                             float v0,
+                             float u1,
+                             float v1,
+                             const boost::optional<Cel::Colour>& highlightColor)
+    {
+        // The level is walked a bit past the screen edges, so plenty of quads never touch the screen
+        if (x >= WIDTH || y >= HEIGHT || x + w <= 0 || y + h <= 0)
+            return;
+
+        if (mNumQuads == MAX_QUADS)
+            flush();
+
+        if (mRuns.empty() || mRuns.back().texture != texture)
+            mRuns.push_back(Run{texture, mNumQuads, 0});
+
+        pushQuad(mVertexData, palette, x, y, w, h, u0, v0, u1, v1, highlightColor);
+
+        mRuns.back().numQuads++;
+        mNumQuads++;
+    }
+
+    void SpriteBatcher::setupProgram(int32_t offsetX, int32_t offsetY)
+    {
+        debug_assert(mProgram != 0);
+
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glActiveTexture(GL_TEXTURE0);
+
+        glUseProgram(mProgram);
+        glUniform1f(mUniformWidth, WIDTH);
+        glUniform1f(mUniformHeight, HEIGHT);
+        glUniform2f(mUniformOffset, offsetX, offsetY);
+    }
+
+    void SpriteBatcher::flush()
+    {
+        if (mNumQuads == 0)
+            return;
+
+        setupProgram(0, 0);
+
+        glBindVertexArray(mVao);
+        glBindBuffer(GL_ARRAY_BUFFER, mVbo);
+        // Respecifying the whole store lets the driver orphan the previous one instead of stalling on it
+        glBufferData(GL_ARRAY_BUFFER, mVertexData.size() * sizeof(Vertex), mVertexData.data(), GL_STREAM_DRAW);
+
+        for (const auto& run : mRuns)
+        {
+            glBindTexture(GL_TEXTURE_2D, run.texture);
+            glDrawElements(GL_TRIANGLES, run.numQuads * 6, GL_UNSIGNED_SHORT, (void*)(run.firstQuad * 6 * sizeof(uint16_t)));
+
+            mDrawCalls++;
+            mVertices += run.numQuads * 4;
+        }
+
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        mVertexData.clear();
+        mRuns.clear();
+        mNumQuads = 0;
+    }
+
+    void SpriteBatcher::upload(StaticSpriteBatch& batch)
+    {
+        debug_assert(batch.mVbo == 0);
+        release_assert(batch.mQuads.size() <= MAX_QUADS);
+
+        std::vector<StaticSpriteBatch::Quad> sorted = batch.mQuads;
+        std::stable_sort(sorted.begin(), sorted.end(), [](const StaticSpriteBatch::Quad& a, const StaticSpriteBatch::Quad& b) {
+            return a.sprite->texture < b.sprite->texture;
+        });
+
+        std::vector<Vertex> vertices;
+        vertices.reserve(sorted.size() * 4);
+
+        for (uint32_t i = 0; i < sorted.size(); i++)
+        {
+            Sprite sprite = sorted[i].sprite;
+
+            if (batch.mRuns.empty() || batch.mRuns.back().texture != sprite->texture)
+                batch.mRuns.push_back(StaticSpriteBatch::Run{sprite->texture, i, 0});
+            batch.mRuns.back().numQuads++;
+
+            pushQuad(vertices,
+                     sprite->palette,
+                     sorted[i].x,
+                     sorted[i].y,
+                     sprite->width,
+                     sprite->height,
+                     sprite->u0,
+                     sprite->v0,
+                     sprite->u1,
+                     sprite->v1,
+                     boost::none);
+        }
+
+        glGenVertexArrays(1, &batch.mVao);
+        glGenBuffers(1, &batch.mVbo);
+
+        glBindBuffer(GL_ARRAY_BUFFER, batch.mVbo);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        setupVertexArray(batch.mVao, batch.mVbo);
+    }
+
+    void SpriteBatcher::drawStatic(const StaticSpriteBatch& batch, int32_t offsetX, int32_t offsetY)
+    {
+        if (batch.mRuns.empty())
+            return;
+
+        // keep the draw order intact
+        flush();
+
+        setupProgram(offsetX, offsetY);
+        glBindVertexArray(batch.mVao);
+
+        for (const auto& run : batch.mRuns)
+        {
+            glBindTexture(GL_TEXTURE_2D, run.texture);
+            glDrawElements(GL_TRIANGLES, run.numQuads * 6, GL_UNSIGNED_SHORT, (void*)(run.firstQuad * 6 * sizeof(uint16_t)));
+
+            mDrawCalls++;
+            mVertices += run.numQuads * 4;
+        }
+
+        glBindVertexArray(0);
+    }
+
+    void SpriteBatcher::resetStats()
+    {
+        mDrawCalls = 0;
+        mVertices = 0;
+    }
+}
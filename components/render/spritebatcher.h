@@ -0,0 +1,134 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include <boost/optional.hpp>
+
+#include "../cel/pal.h"
+#include "misc.h"
+#include "sdl_gl_funcs.h"
+
+namespace Render
+{
+    class SpriteBatcher;
+
+    /// A set of quads that is uploaded to GL once and then drawn any number of times, at an offset given
+    /// at draw time. Used for level geometry that doesn't change from frame to frame.
+    /// The quads are drawn grouped by texture rather than in the order they were added, so they must not overlap.
+    class StaticSpriteBatch
+    {
+    public:
+        struct Quad
+        {
+            Sprite sprite;
+            int32_t x;
+            int32_t y;
+        };
+
+        void add(Sprite sprite, int32_t x, int32_t y) { mQuads.push_back(Quad{sprite, x, y}); }
+        const std::vector<Quad>& quads() const { return mQuads; }
+
+        /// Frees the GL buffers, if it was uploaded, and forgets all quads
+        void clear();
+
+    private:
+        struct Run
+        {
+            GLuint texture;
+            uint32_t firstQuad;
+            uint32_t numQuads;
+        };
+
+        std::vector<Quad> mQuads;
+        std::vector<Run> mRuns;
+        GLuint mVao = 0;
+        GLuint mVbo = 0;
+
+        friend class SpriteBatcher;
+    };
+
+    /// Accumulates textured quads in a CPU side vertex array and submits them through one streaming vertex buffer,
+    /// issuing a single draw call for each run of consecutive quads that share a texture.
+    class SpriteBatcher
+    {
+    public:
+        void init(GLuint program);
+        void destroy();
+
+        /// @param palette palette row for IndexAlpha textures, -1 for RGBA ones
+        void draw(GLuint texture,
+                  int32_t palette,
+                  int32_t x,
+                  int32_t y,
+                  int32_t w,
+                  int32_t h,
+                  float u0,
+                  float v0,
+                  float u1,
+                  float v1,
+                  const boost::optional<Cel::Colour>& highlightColor = boost::none);
+
+        /// Submits all pending quads, must be called before anything else touches GL state and before buffer swaps
+        void flush();
+
+        /// Copies the quads of batch into a GL buffer of its own, must be called once before drawStatic
+        void upload(StaticSpriteBatch& batch);
+        void drawStatic(const StaticSpriteBatch& batch, int32_t offsetX, int32_t offsetY);
+
+        uint32_t drawCalls() const { return mDrawCalls; }
+        uint32_t vertices() const { return mVertices; }
+        void resetStats();
+
+    private:
+        struct Vertex
+        {
+            float x, y;
+            float u, v;
+            float palette;
+            uint8_t highlight[4];
+        };
+
+        struct Run
+        {
+            GLuint texture;
+            uint32_t firstQuad;
+            uint32_t numQuads;
+        };
+
+        static constexpr uint32_t MAX_QUADS = 4096; // keeps vertex indices inside uint16_t
+
+        static void pushQuad(std::vector<Vertex>& vertices,
+                             int32_t palette,
+                             int32_t x,
+                             int32_t y,
+                             int32_t w,
+                             int32_t h,
+                             float u0,
+                             float v0,
+                             float u1,
+                             float v1,
+                             const boost::optional<Cel::Colour>& highlightColor);
+        void setupVertexArray(GLuint vao, GLuint vbo);
+        void setupProgram(int32_t offsetX, int32_t offsetY);
+
+        GLuint mProgram = 0;
+        GLuint mVao = 0;
+        GLuint mVbo = 0;
+        GLuint mEbo = 0;
+        GLint mUniformWidth = -1;
+        GLint mUniformHeight = -1;
+        GLint mUniformOffset = -1;
+        GLint mAttribPos = -1;
+        GLint mAttribUv = -1;
+        GLint mAttribPalette = -1;
+        GLint mAttribHighlight = -1;
+
+        std::vector<Vertex> mVertexData;
+        std::vector<Run> mRuns;
+        uint32_t mNumQuads = 0;
+
+        uint32_t mDrawCalls = 0;
+        uint32_t mVertices = 0;
+    };
+}
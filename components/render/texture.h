@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace Cel
+{
+    class Pal;
+}
+
+namespace Render
+{
+    // Backend agnostic texture storage, used by the sprite loaders and TextureAtlas.
+    // Textures live in GL when rendering to a window, and in system memory when running headless.
+    // Texture name 0 is never returned, so it can be used as "no texture".
+
+    enum class TextureFormat
+    {
+        RGBA,      ///< 4 bytes per pixel
+        IndexAlpha ///< 2 bytes per pixel, a palette index and an alpha, resolved through a palette when drawn
+    };
+
+    int32_t bytesPerPixel(TextureFormat format);
+
+    /// @param pixels width * height tightly packed pixels, or NULL to leave the contents undefined
+    uint32_t createTexture(int32_t width, int32_t height, const uint8_t* pixels, TextureFormat format = TextureFormat::RGBA);
+    void updateTexture(
+        uint32_t texture, int32_t x, int32_t y, int32_t width, int32_t height, const uint8_t* pixels, TextureFormat format = TextureFormat::RGBA);
+    void deleteTexture(uint32_t texture);
+    int32_t maxTextureSize();
+
+    // Palettes for IndexAlpha textures are rows of one shared 256 x MAX_PALETTES palette texture,
+    // TextureReference::palette says which row a frame uses.
+
+    constexpr int32_t MAX_PALETTES = 256;
+
+    /// Returns the row of pal, uploading it first if no identical palette has been added yet
+    int32_t addPalette(const Cel::Pal& pal);
+
+    /// Replaces a palette, every frame drawn with it changes colour without touching the frame textures (eg. for palette cycling)
+    void updatePalette(int32_t palette, const Cel::Pal& pal);
+}
@@ -0,0 +1,130 @@
+#include "textureatlas.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "texture.h"
+
+namespace Render
+{
+    TextureAtlas::TextureAtlas(TextureFormat format, int32_t pageWidth, int32_t pageHeight) : mFormat(format)
+    {
+        mPageWidth = std::min(pageWidth, maxTextureSize());
+        mPageHeight = std::min(pageHeight, maxTextureSize());
+    }
+
+    TextureAtlas::~TextureAtlas()
+    {
+        for (auto& page : mPages)
+            deleteTexture(page.texture);
+    }
+
+    int64_t TextureAtlas::memoryUsage() const
+    {
+        int64_t bytes = 0;
+        for (const auto& page : mPages)
+            bytes += int64_t(page.width) * page.height * bytesPerPixel(mFormat);
+
+        return bytes;
+    }
+
+    void TextureAtlas::fitPageSize(const std::vector<int32_t>& widths, const std::vector<int32_t>& heights, int32_t& pageWidth, int32_t& pageHeight)
+    {
+        int64_t area = 0;
+        int32_t maxWidth = 1;
+        for (size_t i = 0; i < widths.size(); i++)
+        {
+            area += int64_t(widths[i] + 2) * (heights[i] + 2);
+            maxWidth = std::max(maxWidth, widths[i] + 2);
+        }
+
+        // Roughly square, then the height is whatever the shelves below come to
+        pageWidth = 1;
+        while (int64_t(pageWidth) * pageWidth < area && pageWidth < 2048)
+            pageWidth *= 2;
+        pageWidth = std::min(std::max(pageWidth, maxWidth), 2048);
+
+        // The same placement as add()
+        int32_t shelfX = 0;
+        int32_t shelfY = 0;
+        int32_t shelfHeight = 0;
+        for (size_t i = 0; i < widths.size(); i++)
+        {
+            int32_t paddedWidth = widths[i] + 2;
+            if (shelfX + paddedWidth > pageWidth)
+            {
+                shelfX = 0;
+                shelfY += shelfHeight;
+                shelfHeight = 0;
+            }
+
+            shelfX += paddedWidth;
+            shelfHeight = std::max(shelfHeight, heights[i] + 2);
+        }
+
+        pageHeight = std::min(std::max(shelfY + shelfHeight, 1), 2048);
+    }
+
+    TextureAtlas::Page& TextureAtlas::newPage(int32_t minWidth, int32_t minHeight)
+    {
+        // Oversized images (eg. a whole cel strip as one texture) just get a page of their own
+        Page page;
+        page.width = std::max(mPageWidth, minWidth);
+        page.height = std::max(mPageHeight, minHeight);
+        page.shelfX = 0;
+        page.shelfY = 0;
+        page.shelfHeight = 0;
+
+        page.texture = createTexture(page.width, page.height, NULL, mFormat);
+
+        mPages.push_back(page);
+        return mPages.back();
+    }
+
+    TextureReference TextureAtlas::add(const uint8_t* pixels, int32_t width, int32_t height)
+    {
+        int32_t bpp = bytesPerPixel(mFormat);
+        int32_t paddedWidth = width + 2;
+        int32_t paddedHeight = height + 2;
+
+        Page* page = mPages.empty() ? nullptr : &mPages.back();
+        if (page)
+        {
+            if (page->shelfX + paddedWidth > page->width)
+            {
+                page->shelfX = 0;
+                page->shelfY += page->shelfHeight;
+                page->shelfHeight = 0;
+            }
+
+            if (paddedWidth > page->width || page->shelfY + paddedHeight > page->height)
+                page = nullptr;
+        }
+
+        if (!page)
+            page = &newPage(paddedWidth, paddedHeight);
+
+        // Upload the border along with the image, so we never need to clear whole pages
+        mPaddedImage.assign(paddedWidth * paddedHeight * bpp, 0);
+        for (int32_t y = 0; y < height; y++)
+            memcpy(&mPaddedImage[((y + 1) * paddedWidth + 1) * bpp], pixels + y * width * bpp, width * bpp);
+
+        updateTexture(page->texture, page->shelfX, page->shelfY, paddedWidth, paddedHeight, mPaddedImage.data(), mFormat);
+
+        TextureReference ref;
+        ref.texture = page->texture;
+        ref.x = page->shelfX + 1;
+        ref.y = page->shelfY + 1;
+        ref.width = width;
+        ref.height = height;
+        ref.u0 = float(ref.x) / page->width;
+        ref.v0 = float(ref.y) / page->height;
+        ref.u1 = float(ref.x + width) / page->width;
+        ref.v1 = float(ref.y + height) / page->height;
+
+        page->shelfX += paddedWidth;
+        page->shelfHeight = std::max(page->shelfHeight, paddedHeight);
+
+        return ref;
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "misc.h"
+#include "texture.h"
+
+namespace Render
+{
+    /// Packs images of one TextureFormat into a small number of large textures ("pages") using a simple shelf packer.
+    /// Images are stored with a one pixel transparent border, so linear filtering and the highlight
+    /// outline in the sprite shader never pick up texels from a neighbouring image.
+    /// The pages are freed when the atlas is destroyed, so it must only be destroyed on the render thread.
+    class TextureAtlas
+    {
+    public:
+        /// Page sizes are clamped to the largest texture the driver supports
+        explicit TextureAtlas(TextureFormat format = TextureFormat::RGBA, int32_t pageWidth = 2048, int32_t pageHeight = 2048);
+        ~TextureAtlas();
+        TextureAtlas(const TextureAtlas&) = delete;
+        TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+        /// @param pixels width * height tightly packed pixels in the atlas' format
+        TextureReference add(const uint8_t* pixels, int32_t width, int32_t height);
+
+        size_t numPages() const { return mPages.size(); }
+        int64_t memoryUsage() const; ///< Bytes of texture memory used by all pages
+
+        /// The smallest page that fits all the given images, placed in order, up to the default 2048x2048.
+        /// Used for atlases that are only ever filled with one known set of images, so they don't take a whole default page.
+        static void fitPageSize(const std::vector<int32_t>& widths, const std::vector<int32_t>& heights, int32_t& pageWidth, int32_t& pageHeight);
+
+    private:
+        struct Page
+        {
+            uint32_t texture;
+            int32_t width;
+            int32_t height;
+            int32_t shelfX;
+            int32_t shelfY;
+            int32_t shelfHeight;
+        };
+
+        Page& newPage(int32_t minWidth, int32_t minHeight);
+
+        TextureFormat mFormat;
+        std::vector<Page> mPages;
+        std::vector<uint8_t> mPaddedImage;
+        int32_t mPageWidth;
+        int32_t mPageHeight;
+    };
+}
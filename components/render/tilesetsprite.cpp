@@ -0,0 +1,148 @@
+#include "render.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+#include <cel/celfile.h>
+#include <level/min.h>
+#include <misc/assert.h>
+
+namespace Render
+{
+    namespace
+    {
+        constexpr int32_t TILE_SIZE = 32;
+        constexpr int32_t PILLAR_WIDTH = 64;
+        constexpr int32_t PILLAR_HEIGHT = 256;
+
+        /// Runs body(0) to body(count - 1) spread over numThreads threads, the calling thread being one of them
+        void parallelFor(size_t count, int32_t numThreads, const std::function<void(size_t)>& body)
+        {
+            std::atomic<size_t> next(0);
+            auto run = [&]() {
+                for (size_t i = next++; i < count; i = next++)
+                    body(i);
+            };
+
+            std::vector<std::thread> threads;
+            for (int32_t i = 1; i < numThreads && size_t(i) < count; i++)
+                threads.emplace_back(run);
+
+            run();
+
+            for (auto& thread : threads)
+                thread.join();
+        }
+
+        /// Calls f(y, leftFrame, rightFrame) for each row of tiles in the top or bottom part of a pillar, with -1 for a missing tile
+        template <typename F> void forEachPillarRow(const int16_t* pillar, size_t size, bool top, F f)
+        {
+            if (size < 2)
+                return;
+
+            // compensate for maps using 5-row min files
+            int32_t y = size == 10 ? 3 * TILE_SIZE : 0;
+
+            size_t i = top ? 0 : size - 2;
+            size_t lim = top ? size - 2 : size;
+            y += i / 2 * TILE_SIZE;
+
+            for (; i < lim; i += 2, y += TILE_SIZE)
+                f(y, (pillar[i] & 0x0FFF) - 1, (pillar[i + 1] & 0x0FFF) - 1);
+        }
+    }
+
+    SpriteData decodeTilesetSprite(const std::string& celPath, const std::string& minPath, bool top, int32_t numThreads)
+    {
+        if (numThreads <= 0)
+            numThreads = std::max(1, int32_t(std::thread::hardware_concurrency()));
+
+        Cel::CelFile cel(celPath, true);
+        Level::Min min(minPath);
+
+        int32_t numFrames = cel.numFrames();
+        size_t numPillars = min.size() - 1;
+
+        // Pillars share most of their tiles, so each tile used by this half of the tileset is decoded just once, first
+        std::vector<uint8_t> used(numFrames, 0);
+        for (size_t i = 0; i < numPillars; i++)
+        {
+            forEachPillarRow(min[i], min.pillarSize(), top, [&](int32_t, int32_t left, int32_t right) {
+                for (int32_t frame : {left, right})
+                {
+                    if (frame >= 0 && frame < numFrames)
+                        used[frame] = 1;
+                }
+            });
+        }
+
+        std::vector<int32_t> usedFrames;
+        for (int32_t i = 0; i < numFrames; i++)
+        {
+            if (used[i])
+                usedFrames.push_back(i);
+        }
+
+        // Tiles are kept as IndexAlpha, top row first, with transparent pixels all zero, so they can be copied into pillars row by row
+        std::vector<std::vector<uint8_t>> tiles(numFrames);
+        parallelFor(usedFrames.size(), numThreads, [&](size_t i) {
+            int32_t index = usedFrames[i];
+            Cel::CelFrame frame = cel.decodeFrame(index);
+            debug_assert(frame.width() == TILE_SIZE && frame.height() == TILE_SIZE);
+
+            std::vector<uint8_t>& tile = tiles[index];
+            tile.assign(TILE_SIZE * TILE_SIZE * 2, 0);
+
+            int32_t width = std::min(frame.width(), TILE_SIZE);
+            int32_t height = std::min(frame.height(), TILE_SIZE);
+            for (int32_t y = 0; y < height; y++)
+            {
+                // cels are stored bottom up
+                const Cel::Colour* src = &*(frame.begin() + (frame.height() - 1 - y) * frame.width());
+                uint8_t* dest = &tile[y * TILE_SIZE * 2];
+
+                for (int32_t x = 0; x < width; x++)
+                {
+                    if (src[x].visible)
+                    {
+                        dest[x * 2 + 0] = src[x].r;
+                        dest[x * 2 + 1] = 255;
+                    }
+                }
+            }
+        });
+
+        SpriteData data;
+        data.palette = cel.palette();
+        data.animLength = numPillars;
+        data.frames.resize(numPillars);
+
+        parallelFor(numPillars, numThreads, [&](size_t i) {
+            SpriteData::Frame& frame = data.frames[i];
+            frame.width = PILLAR_WIDTH;
+            frame.height = PILLAR_HEIGHT;
+            frame.pixels.assign(PILLAR_WIDTH * PILLAR_HEIGHT * 2, 0);
+
+            // The tiles of a pillar never overlap, so transparent pixels can be copied along with the rest
+            forEachPillarRow(min[i], min.pillarSize(), top, [&](int32_t y, int32_t left, int32_t right) {
+                int32_t x = 0;
+                for (int32_t index : {left, right})
+                {
+                    if (index >= 0 && index < numFrames)
+                    {
+                        const uint8_t* tile = tiles[index].data();
+                        for (int32_t row = 0; row < TILE_SIZE && y + row < PILLAR_HEIGHT; row++)
+                            memcpy(&frame.pixels[((y + row) * PILLAR_WIDTH + x) * 2], tile + row * TILE_SIZE * 2, TILE_SIZE * 2);
+                    }
+
+                    x += TILE_SIZE;
+                }
+            });
+        });
+
+        return data;
+    }
+}
@@ -2,25 +2,33 @@
 precision mediump float;
 
 in vec2 uv;
+flat in float palette;
+in vec4 highlight_color;
 out vec4 frag_colour;
 uniform sampler2D tex;
-uniform float h_color_r;
-uniform float h_color_g;
-uniform float h_color_b;
-uniform float h_color_a;
-uniform float imgW;
-uniform float imgH;
+uniform sampler2D palette_tex;
+
+// palette >= 0 means tex holds (index, alpha) pairs, and palette is the row of palette_tex to look the index up in
+vec4 texel(vec2 coord) {
+    vec4 t = texture(tex, coord);
+    if (palette < 0.)
+        return t;
+
+    vec4 c = texelFetch(palette_tex, ivec2(int(t.r * 255. + 0.5), int(palette)), 0);
+    return vec4(c.rgb, t.g);
+}
 
 void main() {
-    vec4 c = texture(tex, uv);
-    if (c.w == 0. && h_color_a > 0.)
+    vec4 c = texel(uv);
+    if (c.w == 0. && highlight_color.a > 0.)
     {
+      vec2 texelSize = 1.0 / vec2(textureSize(tex, 0));
       for (float i= -1.; i <= 1.; i++)
         for (float j= -1.; j <= 1.; j++)
             {
-              vec4 n = texture(tex, vec2 (uv.x + i/imgW, uv.y + j/imgH));
+              vec4 n = texel(vec2 (uv.x + i*texelSize.x, uv.y + j*texelSize.y));
               if (n.w > 0. && (n.x > 0. || n.y > 0. || n.z > 0.))
-                c = vec4 (h_color_r, h_color_g, h_color_b, h_color_a);
+                c = highlight_color;
             }
     }
 	frag_colour = c;//vec4(c.r, c.g, c.b, 0.4 * c.a);
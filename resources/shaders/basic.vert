@@ -1,18 +1,21 @@
 #version 150
 precision mediump float;
 
-in vec3 vertex_position;
+in vec2 vertex_position;
 in vec2 v_uv;
+in float v_palette;
+in vec4 v_highlight_color;
 out vec2 uv;
+flat out float palette;
+out vec4 highlight_color;
 uniform float width;
 uniform float height;
-uniform float imgW;
-uniform float imgH;
-uniform float offsetX;
-uniform float offsetY;
+uniform vec2 offset;
 void main() {
     uv = v_uv;
-    gl_Position = vec4((vec2(vertex_position.x*imgW + offsetX, vertex_position.y*imgH + offsetY) / vec2(width, height)) * 2.0, 0.0, 1.0);
+    palette = v_palette;
+    highlight_color = v_highlight_color;
+    gl_Position = vec4(((vertex_position + offset) / vec2(width, height)) * 2.0, 0.0, 1.0);
     gl_Position.x = gl_Position.x - 1.0;
     gl_Position.y = 1.0 - gl_Position.y;
 }
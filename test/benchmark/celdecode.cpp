@@ -0,0 +1,159 @@
+#include <benchmark/benchmark.h>
+#include <cel/celfile.h>
+#include <cel/celkernels.h>
+#include <chrono>
+#include <faio/faio.h>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <misc/md5.h>
+#include <misc/stringops.h>
+#include <sstream>
+
+// Decodes every frame of every cel/cl2 in test/Diablo I.txt, and reports the decoded bytes per second.
+// Only the decoding is timed, reading the files from the mpq is not. The argument is 1 to decode to palette
+// indices, as the sprite loaders do, or 0 to decode to colours. Frames are checked against
+// test/cel_hashes.txt on the first pass, so a broken kernel fails the run rather than just looking fast.
+// BM_DecodeTilesets does the same for just the town and l1-l4 tilesets, which are the only cels with frames of
+// more than one type, and most of what gets decoded when a level loads.
+// Needs DIABDAT.MPQ in the working directory, and skips itself if it can't find one.
+
+static std::vector<std::string> readLines(const std::string& path)
+{
+    std::ifstream in(path);
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (!line.empty() && line.back() == '\r')
+            line.pop_back();
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+static std::vector<std::string> getCelPaths()
+{
+    std::vector<std::string> celPaths;
+    for (std::string path : readLines(TEST_DIR "/Diablo I.txt"))
+    {
+        Misc::StringUtils::toLower(path);
+        if (!Misc::StringUtils::endsWith(path, ".cel") && !Misc::StringUtils::endsWith(path, ".cl2"))
+            continue;
+
+        // both broken, see the Cel tests
+        if (Misc::StringUtils::endsWith(path, "unravw.cel") || path == "monsters\\darkmage\\dmagew.cl2")
+            continue;
+
+        if (FAIO::exists(path))
+            celPaths.push_back(path);
+    }
+    return celPaths;
+}
+
+static std::map<std::string, std::vector<std::string>> getCelHashes()
+{
+    std::map<std::string, std::vector<std::string>> hashes;
+    for (const auto& line : readLines(TEST_DIR "/cel_hashes.txt"))
+    {
+        auto components = Misc::StringUtils::split(line, ',');
+        std::string path = components[0];
+        components.erase(components.begin());
+        hashes[path] = components;
+    }
+    return hashes;
+}
+
+static std::string hashFrame(const Cel::CelFrame& frame, const Cel::Pal& palette, bool indices)
+{
+    std::vector<Cel::Colour> colours(frame.begin(), frame.end());
+
+    // the saved hashes are of colours, so look the indices up the same way the sprite shader does
+    if (indices)
+    {
+        for (auto& colour : colours)
+        {
+            if (colour.visible)
+                colour = palette[colour.r];
+        }
+    }
+
+    Misc::md5_state_t state;
+    Misc::md5_byte_t digest[16];
+    md5_init(&state);
+    md5_append(&state, reinterpret_cast<const Misc::md5_byte_t*>(colours.data()), colours.size() * sizeof(Cel::Colour));
+    md5_finish(&state, digest);
+
+    std::stringstream s;
+    for (int32_t i = 0; i < 16; i++)
+        s << std::hex << std::setw(2) << std::setfill('0') << int32_t(digest[i]);
+    return s.str();
+}
+
+static std::vector<std::string> getTilesetPaths()
+{
+    return {"levels\\towndata\\town.cel", "levels\\l1data\\l1.cel", "levels\\l2data\\l2.cel", "levels\\l3data\\l3.cel", "levels\\l4data\\l4.cel"};
+}
+
+static void decodeCels(benchmark::State& state, std::vector<std::string> (*getPaths)())
+{
+    if (!FAIO::init())
+    {
+        state.SkipWithError("Could not open DIABDAT.MPQ");
+        return;
+    }
+
+    bool indices = state.range(0) == 1;
+    std::vector<std::string> celPaths = getPaths();
+    auto celHashes = getCelHashes();
+
+    int64_t bytesDecoded = 0;
+    bool verified = false;
+
+    while (state.KeepRunning())
+    {
+        std::chrono::duration<double> decodeTime(0);
+
+        for (const auto& path : celPaths)
+        {
+            Cel::CelFile cel(path, indices);
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int32_t i = 0; i < cel.numFrames(); i++)
+                benchmark::DoNotOptimize(cel[i]);
+            decodeTime += std::chrono::high_resolution_clock::now() - start;
+
+            for (int32_t i = 0; i < cel.numFrames(); i++)
+            {
+                bytesDecoded += int64_t(cel[i].width()) * cel[i].height() * sizeof(Cel::Colour);
+
+                if (verified)
+                    continue;
+
+                const auto& hashes = celHashes[path];
+                if (size_t(i) >= hashes.size() || hashFrame(cel[i], cel.palette(), indices) != hashes[i])
+                {
+                    state.SkipWithError(("Wrong pixels decoded from " + path + "[" + std::to_string(i) + "]").c_str());
+                    FAIO::quit();
+                    return;
+                }
+            }
+        }
+
+        verified = true;
+        state.SetIterationTime(decodeTime.count());
+    }
+
+    state.SetBytesProcessed(bytesDecoded);
+    state.SetLabel(Cel::kernelsName());
+
+    FAIO::quit();
+}
+
+static void BM_DecodeAllCels(benchmark::State& state) { decodeCels(state, getCelPaths); }
+BENCHMARK(BM_DecodeAllCels)->Arg(0)->Arg(1)->UseManualTime()->Unit(benchmark::kMillisecond);
+
+static void BM_DecodeTilesets(benchmark::State& state) { decodeCels(state, getTilesetPaths); }
+BENCHMARK(BM_DecodeTilesets)->Arg(0)->Arg(1)->UseManualTime()->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
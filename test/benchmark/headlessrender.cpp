@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <faio/faio.h>
+#include <farender/spritemanager.h>
+#include <level/dun.h>
+#include <level/level.h>
+#include <render/levelobjects.h>
+#include <render/render.h>
+
+// Draws the town through the software renderer, so it can run on build machines without a GPU.
+// Needs DIABDAT.MPQ in the working directory, and skips itself if it can't find one.
+// The last frame drawn is saved to headlessrender.png, so regressions can be checked by eye.
+
+static constexpr int32_t screenWidth = 1280;
+static constexpr int32_t screenHeight = 960;
+
+static Level::Level loadTown()
+{
+    Level::Dun sector1("levels/towndata/sector1s.dun");
+    Level::Dun sector2("levels/towndata/sector2s.dun");
+    Level::Dun sector3("levels/towndata/sector3s.dun");
+    Level::Dun sector4("levels/towndata/sector4s.dun");
+
+    // same as in FAWorld::World::generateLevels
+    std::map<int32_t, int32_t> specialCelMap = {
+        {357, 1}, {128, 5}, {129, 6}, {127, 7}, {116, 8}, {156, 9}, {157, 10}, {155, 11}, {161, 12}, {159, 13}, {213, 14}, {211, 15}, {216, 16}, {215, 17}};
+
+    return Level::Level(Level::Dun::getTown(sector1, sector2, sector3, sector4),
+                        "levels/towndata/town.til",
+                        "levels/towndata/town.min",
+                        "levels/towndata/town.sol",
+                        "levels/towndata/town.cel",
+                        "levels/towndata/towns.cel",
+                        specialCelMap,
+                        Misc::Point(25u, 29u),
+                        Misc::Point(75u, 68u),
+                        std::map<int32_t, int32_t>(),
+                        static_cast<int32_t>(-1),
+                        1);
+}
+
+static void BM_HeadlessDrawTown(benchmark::State& state)
+{
+    if (!FAIO::init())
+    {
+        state.SkipWithError("Could not open DIABDAT.MPQ");
+        return;
+    }
+
+    Render::RenderSettings settings;
+    settings.windowWidth = screenWidth;
+    settings.windowHeight = screenHeight;
+    settings.fullscreen = false;
+    settings.headless = true;
+
+    Render::NuklearGraphicsContext nuklearGraphics;
+    Render::init("headlessrender benchmark", settings, nuklearGraphics, nullptr);
+
+    {
+        Level::Level level = loadTown();
+
+        FARender::SpriteManager spriteManager(256 * 1024 * 1024);
+        size_t minTops = spriteManager.getTileset("levels/towndata/town.cel", "levels/towndata/town.min", true)->getCacheIndex();
+        size_t minBottoms = spriteManager.getTileset("levels/towndata/town.cel", "levels/towndata/town.min", false)->getCacheIndex();
+        size_t specialSprites = spriteManager.get("levels/towndata/towns.cel")->getCacheIndex();
+
+        Render::LevelObjects objects(level.width(), level.height());
+        Render::LevelObjects items(level.width(), level.height());
+
+        double maxFrameMs = 0.0;
+        int32_t frame = 0;
+
+        while (state.KeepRunning())
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+
+            // pan across the middle of town, so we aren't just measuring one view
+            Misc::Point pos(25 + frame % 50, 29 + frame % 40);
+
+            Render::clear(0, 0, 0);
+            Render::drawLevel(
+                level, minTops, minBottoms, specialSprites, level.getSpecialCelMap(), &spriteManager, objects, items, pos, Misc::Point(0, 0));
+            Render::draw();
+
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+            maxFrameMs = std::max(maxFrameMs, elapsed.count());
+            frame++;
+        }
+
+        Render::RenderStats stats = Render::getRenderStats();
+        state.counters["max_frame_ms"] = maxFrameMs;
+        state.counters["draw_calls"] = stats.drawCalls;
+
+        Render::saveScreenshot("headlessrender.png");
+
+        spriteManager.clear();
+    }
+
+    Render::quit();
+    FAIO::quit();
+}
+BENCHMARK(BM_HeadlessDrawTown)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,126 @@
+#include <atomic>
+#include <benchmark/benchmark.h>
+#include <condition_variable>
+#include <faio/fafileobject.h>
+#include <fstream>
+#include <misc/stringops.h>
+#include <mutex>
+#include <thread>
+
+// Reads every cel and cl2 in test/Diablo I.txt out of the MPQ, split between a number of threads (the argument),
+// and reports the bytes read per second. With each thread reading through its own archive handle, this should
+// scale with the number of cores, until decompression stops being the bottleneck.
+// The threads are started, and have read everything once, before timing begins, so each iteration only measures the reads.
+// Needs DIABDAT.MPQ in the working directory, and skips itself if it can't find one.
+
+static std::vector<std::string> getMpqPaths()
+{
+    std::ifstream in(TEST_DIR "/Diablo I.txt");
+    std::vector<std::string> paths;
+    std::string path;
+    while (std::getline(in, path))
+    {
+        if (!path.empty() && path.back() == '\r')
+            path.pop_back();
+
+        Misc::StringUtils::toLower(path);
+        if (!Misc::StringUtils::endsWith(path, ".cel") && !Misc::StringUtils::endsWith(path, ".cl2"))
+            continue;
+
+        // FAfopen refuses to open these, see the Cel tests
+        if (Misc::StringUtils::endsWith(path, "unravw.cel") || Misc::StringUtils::endsWith(path, "dmagew.cl2"))
+            continue;
+
+        if (FAIO::exists(path))
+            paths.push_back(path);
+    }
+    return paths;
+}
+
+static void BM_ReadAllCels(benchmark::State& state)
+{
+    if (!FAIO::init())
+    {
+        state.SkipWithError("Could not open DIABDAT.MPQ");
+        return;
+    }
+
+    std::vector<std::string> paths = getMpqPaths();
+    int32_t numThreads = state.range(0);
+    int64_t bytesRead = 0;
+
+    std::atomic<size_t> nextPath(0);
+    std::atomic<int64_t> iterationBytes(0);
+
+    // Each round, every worker reads files until there are none left, then reports in
+    std::mutex mutex;
+    std::condition_variable roundStarted;
+    std::condition_variable roundFinished;
+    int64_t round = 0;
+    int32_t workersDone = 0;
+    bool stop = false;
+
+    auto worker = [&]() {
+        std::vector<uint8_t> buffer;
+        int64_t lastRound = 0;
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                roundStarted.wait(lock, [&]() { return stop || round != lastRound; });
+                if (stop)
+                    return;
+                lastRound = round;
+            }
+
+            for (size_t i = nextPath++; i < paths.size(); i = nextPath++)
+            {
+                FAIO::FAFileObject file(paths[i]);
+                buffer.resize(file.FAsize());
+                iterationBytes += file.FAfread(buffer.data(), 1, buffer.size());
+            }
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (++workersDone == numThreads)
+                roundFinished.notify_one();
+        }
+    };
+
+    auto runRound = [&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        nextPath = 0;
+        iterationBytes = 0;
+        workersDone = 0;
+        round++;
+        roundStarted.notify_all();
+        roundFinished.wait(lock, [&]() { return workersDone == numThreads; });
+    };
+
+    std::vector<std::thread> threads;
+    for (int32_t i = 0; i < numThreads; i++)
+        threads.emplace_back(worker);
+
+    // warm up, so each thread has its archive handle open and the OS has the MPQ cached
+    runRound();
+
+    while (state.KeepRunning())
+    {
+        runRound();
+        bytesRead += iterationBytes;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+        roundStarted.notify_all();
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    state.SetBytesProcessed(bytesRead);
+
+    FAIO::quit();
+}
+BENCHMARK(BM_ReadAllCels)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
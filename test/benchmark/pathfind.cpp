@@ -0,0 +1,95 @@
+#include "../unit/findpath/levelimplstub.h"
+#include <benchmark/benchmark.h>
+#include <faworld/findpath.h>
+#include <random>
+
+// Measures pathFind on generated 100x100 levels, reporting paths found per second. The first argument is the percentage of
+// tiles that are walls, scattered at random, the second the PathFindMode, 0 for A* and 1 for jump point search. Starts and
+// goals are picked once up front from the passable tiles, so the same searches run every iteration, with goals anywhere on
+// the level, including ones A* gives up on (the reachable counter is the fraction that were found).
+// BM_PathFindFreshContext gives every A* search a new PathFindContext, which is what each search used to allocate.
+
+namespace
+{
+    const int32_t LEVEL_SIZE = 100;
+    const size_t NUM_SEARCHES = 256;
+
+    struct Search
+    {
+        Misc::Point start;
+        Misc::Point goal;
+    };
+
+    FAWorld::LevelImplStub makeLevel(int32_t wallPercent, std::vector<Search>& searches)
+    {
+        std::mt19937 rng(0);
+        std::uniform_int_distribution<int32_t> percent(0, 99);
+        std::uniform_int_distribution<int32_t> coordinate(0, LEVEL_SIZE - 1);
+
+        std::vector<std::vector<int>> map(LEVEL_SIZE, std::vector<int>(LEVEL_SIZE, 0));
+        for (auto& row : map)
+        {
+            for (auto& tile : row)
+                tile = percent(rng) < wallPercent ? 1 : 0;
+        }
+
+        auto randomPassable = [&]() {
+            Misc::Point point;
+            do
+                point = Misc::Point(coordinate(rng), coordinate(rng));
+            while (map[point.y][point.x] != 0);
+            return point;
+        };
+
+        searches.clear();
+        for (size_t i = 0; i < NUM_SEARCHES; i++)
+            searches.push_back({randomPassable(), randomPassable()});
+
+        return FAWorld::LevelImplStub(std::move(map));
+    }
+}
+
+static void BM_PathFind(benchmark::State& state)
+{
+    std::vector<Search> searches;
+    FAWorld::LevelImplStub level = makeLevel(state.range(0), searches);
+
+    FAWorld::PathFindContext context(static_cast<FAWorld::PathFindMode>(state.range(1)));
+    int64_t reachable = 0;
+
+    while (state.KeepRunning())
+    {
+        for (const Search& search : searches)
+        {
+            bool arrivable = false;
+            benchmark::DoNotOptimize(FAWorld::pathFind(context, &level, nullptr, search.start, search.goal, arrivable, false));
+            reachable += arrivable;
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * searches.size());
+    state.counters["reachable"] = double(reachable) / (state.iterations() * searches.size());
+    state.SetLabel(context.mode() == FAWorld::PathFindMode::JumpPoint ? "jump point" : "A*");
+}
+BENCHMARK(BM_PathFind)->Args({0, 0})->Args({0, 1})->Args({20, 0})->Args({20, 1})->Args({35, 0})->Args({35, 1});
+
+static void BM_PathFindFreshContext(benchmark::State& state)
+{
+    std::vector<Search> searches;
+    FAWorld::LevelImplStub level = makeLevel(state.range(0), searches);
+
+    while (state.KeepRunning())
+    {
+        for (const Search& search : searches)
+        {
+            FAWorld::PathFindContext context(FAWorld::PathFindMode::AStar);
+            bool arrivable = false;
+            benchmark::DoNotOptimize(FAWorld::pathFind(context, &level, nullptr, search.start, search.goal, arrivable, false));
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * searches.size());
+}
+BENCHMARK(BM_PathFindFreshContext)->Arg(0)->Arg(20)->Arg(35);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,42 @@
+#include <benchmark/benchmark.h>
+#include <farender/spritecache.h>
+#include <random>
+
+// Measures SpriteCache::get(uint32_t) on cache hits, which is what the render thread does for every tile, item and actor it draws.
+// The sprites are empty groups put in with directInsert, so no textures or data files are needed.
+
+static void BM_SpriteCacheGet(benchmark::State& state)
+{
+    int32_t residentCount = static_cast<int32_t>(state.range(0));
+
+    FARender::SpriteCache cache(256 * 1024 * 1024, 0);
+
+    std::vector<uint32_t> indices;
+    for (int32_t i = 0; i < residentCount; i++)
+    {
+        uint32_t index = cache.newUniqueIndex();
+        cache.directInsert(new Render::SpriteGroup(std::vector<Render::TextureReference>()), index);
+        indices.push_back(index);
+    }
+
+    // A frame touches a few hundred distinct groups, many of them repeatedly (floor tiles, walls), so sample with a skew
+    // towards a hot subset instead of uniformly.
+    std::mt19937 rng(0);
+    std::geometric_distribution<int32_t> hot(0.01);
+    std::vector<uint32_t> lookups(4096);
+    for (auto& lookup : lookups)
+        lookup = indices[hot(rng) % residentCount];
+
+    while (state.KeepRunning())
+    {
+        for (uint32_t index : lookups)
+            benchmark::DoNotOptimize(cache.get(index));
+    }
+
+    state.SetItemsProcessed(state.iterations() * lookups.size());
+
+    cache.clear();
+}
+BENCHMARK(BM_SpriteCacheGet)->Arg(256)->Arg(1024)->Arg(4096);
+
+BENCHMARK_MAIN();
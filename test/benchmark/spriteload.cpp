@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <faio/faio.h>
+#include <farender/spritemanager.h>
+#include <render/render.h>
+
+// Simulates entering a level: the town tileset and a handful of monster types are requested at once,
+// then frames are drawn until every sprite has been loaded. The interesting number is max_frame_ms,
+// the worst hitch the render thread saw while that happened. The argument is the number of decode threads,
+// 0 decodes everything on the render thread, as it was before the decode pool existed.
+// Needs DIABDAT.MPQ in the working directory, and skips itself if it can't find one.
+
+static const char* monsterPaths[] = {"monsters/zombie/zombiew.cl2",
+                                     "monsters/zombie/zombiea.cl2",
+                                     "monsters/falsword/fallw.cl2",
+                                     "monsters/falsword/falla.cl2",
+                                     "monsters/skelaxe/sklaxw.cl2",
+                                     "monsters/skelaxe/sklaxa.cl2",
+                                     "monsters/scav/scavw.cl2",
+                                     "monsters/goatmace/goatw.cl2",
+                                     "monsters/fat/fatw.cl2"};
+
+static void BM_EnterLevel(benchmark::State& state)
+{
+    if (!FAIO::init())
+    {
+        state.SkipWithError("Could not open DIABDAT.MPQ");
+        return;
+    }
+
+    Render::RenderSettings settings;
+    settings.windowWidth = 1280;
+    settings.windowHeight = 960;
+    settings.fullscreen = false;
+    settings.headless = true;
+
+    Render::NuklearGraphicsContext nuklearGraphics;
+    Render::init("spriteload benchmark", settings, nuklearGraphics, nullptr);
+
+    double maxFrameMs = 0.0;
+    int32_t frames = 0;
+
+    while (state.KeepRunning())
+    {
+        FARender::SpriteManager spriteManager(256 * 1024 * 1024, state.range(0));
+
+        // the game thread side, done before any frame that uses them
+        std::vector<uint32_t> handles;
+        handles.push_back(spriteManager.getTileset("levels/towndata/town.cel", "levels/towndata/town.min", true)->getCacheIndex());
+        handles.push_back(spriteManager.getTileset("levels/towndata/town.cel", "levels/towndata/town.min", false)->getCacheIndex());
+        for (const char* path : monsterPaths)
+            handles.push_back(spriteManager.get(path)->getCacheIndex());
+
+        do
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+
+            Render::clear(0, 0, 0);
+            int32_t x = 0;
+            for (uint32_t handle : handles)
+            {
+                Render::SpriteGroup* sprite = spriteManager.get(handle);
+                Render::drawSprite((*sprite)[0], x, 100);
+                x += 100;
+            }
+            Render::draw();
+
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+            maxFrameMs = std::max(maxFrameMs, elapsed.count());
+            frames++;
+        } while (spriteManager.getCacheStats().pendingDecodes > 0);
+
+        spriteManager.clear();
+    }
+
+    state.counters["max_frame_ms"] = maxFrameMs;
+    state.counters["frames_per_load"] = double(frames) / state.iterations();
+
+    Render::quit();
+    FAIO::quit();
+}
+BENCHMARK(BM_EnterLevel)->Arg(0)->Arg(FARender::SpriteDecoder::defaultNumThreads())->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,121 @@
+#include <SDL.h>
+#include <benchmark/benchmark.h>
+#include <render/misc.h>
+#include <render/render.h>
+#include <render/sdl_gl_funcs.h>
+
+// Compares the old way of getting sprite dimensions (bind the texture and ask the driver)
+// with reading them from the SpriteGroup. One benchmark iteration is one frame's worth of
+// size queries, which is roughly what drawLevel does for items, objects and special sprites.
+
+static constexpr int32_t spritesPerFrame = 512;
+
+class HiddenGlWindow
+{
+public:
+    HiddenGlWindow()
+    {
+        SDL_Init(SDL_INIT_VIDEO);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+        SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 2);
+
+        mWindow = SDL_CreateWindow("spritesize benchmark", 0, 0, 64, 64, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+        if (mWindow)
+            mContext = SDL_GL_CreateContext(mWindow);
+
+        if (mContext)
+            initGlFuncs();
+    }
+
+    ~HiddenGlWindow()
+    {
+        if (mContext)
+            SDL_GL_DeleteContext(mContext);
+        if (mWindow)
+            SDL_DestroyWindow(mWindow);
+        SDL_Quit();
+    }
+
+    bool valid() const { return mContext != nullptr; }
+
+private:
+    SDL_Window* mWindow = nullptr;
+    SDL_GLContext mContext = nullptr;
+};
+
+static std::vector<Render::TextureReference> makeTextures()
+{
+    std::vector<Render::TextureReference> frames(spritesPerFrame);
+
+    for (int32_t i = 0; i < spritesPerFrame; i++)
+    {
+        GLuint tex = 0;
+        glGenTextures(1, &tex);
+        glBindTexture(GL_TEXTURE_2D, tex);
+        frames[i].width = 32 + (i % 64);
+        frames[i].height = 64 + (i % 96);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, frames[i].width, frames[i].height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        frames[i].texture = tex;
+    }
+
+    return frames;
+}
+
+static void BM_SpriteSizeGlQuery(benchmark::State& state)
+{
+    HiddenGlWindow window;
+    if (!window.valid())
+    {
+        state.SkipWithError("Could not create an OpenGL context");
+        return;
+    }
+
+    Render::SpriteGroup group(makeTextures());
+
+    while (state.KeepRunning())
+    {
+        for (int32_t i = 0; i < spritesPerFrame; i++)
+        {
+            GLint w = 0, h = 0;
+            glBindTexture(GL_TEXTURE_2D, group[i]->texture);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &w);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &h);
+            benchmark::DoNotOptimize(w);
+            benchmark::DoNotOptimize(h);
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * spritesPerFrame);
+    group.destroy();
+}
+BENCHMARK(BM_SpriteSizeGlQuery);
+
+static void BM_SpriteSizeCached(benchmark::State& state)
+{
+    HiddenGlWindow window;
+    if (!window.valid())
+    {
+        state.SkipWithError("Could not create an OpenGL context");
+        return;
+    }
+
+    Render::SpriteGroup group(makeTextures());
+
+    while (state.KeepRunning())
+    {
+        for (int32_t i = 0; i < spritesPerFrame; i++)
+        {
+            int32_t w = group.getWidth(i);
+            int32_t h = group.getHeight(i);
+            benchmark::DoNotOptimize(w);
+            benchmark::DoNotOptimize(h);
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * spritesPerFrame);
+    group.destroy();
+}
+BENCHMARK(BM_SpriteSizeCached);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,58 @@
+#include <benchmark/benchmark.h>
+#include <faio/faio.h>
+#include <render/render.h>
+
+// Builds both halves of a level's tileset (the pillar sprites drawLevel draws), the way the sprite cache does on entering a level.
+// The first argument is the level type, 0 for the town and 1-4 for l1-l4, the second the number of threads, 0 for one per core.
+// Only decoding and compositing are measured, nothing is uploaded, so no window is needed.
+// Needs DIABDAT.MPQ in the working directory, and skips itself if it can't find one.
+
+static const char* tilesetPaths[][2] = {{"levels/towndata/town.cel", "levels/towndata/town.min"},
+                                        {"levels/l1data/l1.cel", "levels/l1data/l1.min"},
+                                        {"levels/l2data/l2.cel", "levels/l2data/l2.min"},
+                                        {"levels/l3data/l3.cel", "levels/l3data/l3.min"},
+                                        {"levels/l4data/l4.cel", "levels/l4data/l4.min"}};
+
+static void BM_BuildTileset(benchmark::State& state)
+{
+    if (!FAIO::init())
+    {
+        state.SkipWithError("Could not open DIABDAT.MPQ");
+        return;
+    }
+
+    const char* celPath = tilesetPaths[state.range(0)][0];
+    const char* minPath = tilesetPaths[state.range(0)][1];
+    int32_t numThreads = state.range(1);
+    int64_t pillars = 0;
+
+    while (state.KeepRunning())
+    {
+        for (bool top : {true, false})
+        {
+            Render::SpriteData data = Render::decodeTilesetSprite(celPath, minPath, top, numThreads);
+            pillars += data.frames.size();
+            benchmark::DoNotOptimize(data.frames.data());
+        }
+    }
+
+    state.SetItemsProcessed(pillars);
+    state.SetLabel(celPath);
+
+    FAIO::quit();
+}
+BENCHMARK(BM_BuildTileset)
+    ->Args({0, 1})
+    ->Args({0, 0})
+    ->Args({1, 1})
+    ->Args({1, 0})
+    ->Args({2, 1})
+    ->Args({2, 0})
+    ->Args({3, 1})
+    ->Args({3, 0})
+    ->Args({4, 1})
+    ->Args({4, 0})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
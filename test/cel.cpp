@@ -301,6 +301,31 @@ TEST(Cel, TestOpen)
     ASSERT_EQ(succeededFrames, totalFrames);
 }
 
+TEST(Cel, FrameSizesFromHeader)
+{
+    std::string thisFolder = bfs::path(__FILE__).parent_path().string();
+
+    for (auto p : getCelsFromListfile(thisFolder + "/Diablo I.txt"))
+    {
+        if (Misc::StringUtils::endsWith(p, "unravw.cel") || p == "monsters\\darkmage\\dmagew.cl2") // broken, see TestOpen
+            continue;
+
+        std::vector<int32_t> widths, heights;
+        int32_t animLength;
+        Cel::CelDecoder::getFrameSizes(p, widths, heights, animLength);
+
+        Cel::CelFile cel(p);
+        ASSERT_EQ(cel.numFrames(), int32_t(widths.size())) << p;
+        ASSERT_EQ(cel.animLength(), animLength) << p;
+
+        for (int32_t i = 0; i < cel.numFrames(); i++)
+        {
+            EXPECT_EQ(cel[i].width(), widths[i]) << p << "[" << i << "]";
+            EXPECT_EQ(cel[i].height(), heights[i]) << p << "[" << i << "]";
+        }
+    }
+}
+
 int main(int argc, char** argv)
 {
     FAIO::init();
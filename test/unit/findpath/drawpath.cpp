@@ -1,5 +1,6 @@
 #include "drawpath.h"
 
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 
@@ -5,6 +5,7 @@
 
 #include <algorithm>
 #include <boost/make_unique.hpp>
+#include <cstdlib>
 #include <gtest/gtest.h>
 
 using Point = Misc::Point;
@@ -112,6 +113,22 @@ TEST_P(FindPathPatternsTest, pathIsWalkable)
         ASSERT_TRUE(level->isPassable(tile, nullptr));
 }
 
+TEST_P(FindPathPatternsTest, aStarPathIsShort)
+{
+    FAWorld::PathFindContext context(FAWorld::PathFindMode::AStar);
+    auto path = FAWorld::pathFind(context, level.get(), nullptr, GetParam().start, GetParam().goal, isReachable, false);
+
+    ASSERT_TRUE(isReachable);
+    ASSERT_EQ(path.size(), GetParam().expectedStepsAmount);
+
+    for (size_t index = 0; index < path.size() - 1; ++index)
+    {
+        auto possibleRoute = FAWorld::neighbors(level.get(), nullptr, path.at(index));
+
+        ASSERT_NE(std::find(possibleRoute.begin(), possibleRoute.end(), path.at(index + 1)), possibleRoute.end());
+    }
+}
+
 INSTANTIATE_TEST_CASE_P(FindPathPatternsParams,
                         FindPathPatternsTest,
                         ::testing::Values(FindPathPatternsParams{"Walk #1", basicMap(), Point(2, 3), Point{18, 5}, 17},
@@ -173,6 +190,77 @@ TEST(FindPathTests, walksOnLargeMap)
     ASSERT_EQ(path.size(), map_size);
 }
 
+TEST(FindPathTests, contextIsReusableAcrossLevels)
+{
+    FAWorld::LevelImplStub small(Map{{0, 0, 0, 0, 0}, //
+                                     {0, 1, 1, 1, 0}, //
+                                     {0, 0, 0, 0, 0}});
+    FAWorld::LevelImplStub large(basicMap());
+
+    FAWorld::PathFindContext context;
+    bool isReachable = false;
+
+    auto expectedSmall = FAWorld::pathFind(&small, nullptr, Point{0, 1}, Point{4, 1}, isReachable, false);
+    auto expectedLarge = FAWorld::pathFind(&large, nullptr, Point{2, 3}, Point{18, 5}, isReachable, false);
+
+    // Each search has to ignore whatever the last one left in the context
+    for (int i = 0; i < 3; i++)
+    {
+        ASSERT_EQ(FAWorld::pathFind(context, &small, nullptr, Point{0, 1}, Point{4, 1}, isReachable, false), expectedSmall);
+        ASSERT_TRUE(isReachable);
+        ASSERT_EQ(FAWorld::pathFind(context, &large, nullptr, Point{2, 3}, Point{18, 5}, isReachable, false), expectedLarge);
+        ASSERT_TRUE(isReachable);
+    }
+}
+
+TEST(FindPathTests, findsPathsAStarGivesUpOn)
+{
+    // A wall down nearly the whole middle of the map, so the way round is far longer than A* will search
+    const size_t map_size = 200;
+    Map map{map_size, std::vector<int>(map_size, 0)};
+    for (size_t y = 0; y < map_size - 1; y++)
+        map[y][map_size / 2] = 1;
+
+    FAWorld::LevelImplStub level(map);
+    const Point start{0, 0};
+    const Point goal{map_size - 1, 0};
+
+    bool isReachable = false;
+    FAWorld::PathFindContext aStar(FAWorld::PathFindMode::AStar);
+    FAWorld::pathFind(aStar, &level, nullptr, start, goal, isReachable, false);
+    ASSERT_FALSE(isReachable);
+
+    auto path = FAWorld::pathFind(&level, nullptr, start, goal, isReachable, false);
+
+    ASSERT_TRUE(isReachable);
+    ASSERT_EQ(path.front(), start);
+    ASSERT_EQ(path.back(), goal);
+
+    for (auto tile : path)
+        ASSERT_TRUE(level.isPassable(tile, nullptr));
+}
+
+TEST(FindPathTests, givesUpOnUnreachableGoals)
+{
+    Map map{50, std::vector<int>(50, 0)};
+    for (size_t i = 20; i <= 30; i++)
+        map[20][i] = map[30][i] = map[i][20] = map[i][30] = 1;
+
+    FAWorld::LevelImplStub level(map);
+
+    bool isReachable = true;
+    auto path = FAWorld::pathFind(&level, nullptr, Point{0, 0}, Point{25, 25}, isReachable, false);
+    EXPECT_EQ(path.size(), 0);
+    EXPECT_FALSE(isReachable);
+
+    // the goal is a wall, so the search stops next to it instead
+    path = FAWorld::pathFind(&level, nullptr, Point{0, 0}, Point{30, 25}, isReachable, false);
+    ASSERT_TRUE(isReachable);
+    EXPECT_LE(std::abs(path.back().x - 30), 1);
+    EXPECT_LE(std::abs(path.back().y - 25), 1);
+    EXPECT_TRUE(level.isPassable(path.back(), nullptr));
+}
+
 TEST(FindPathTests, pathfinderIsLimited)
 {
     const size_t map_size = 5000;
@@ -183,8 +271,10 @@ TEST(FindPathTests, pathfinderIsLimited)
 
     FAWorld::LevelImplStub level(map);
 
+    // jump point search would cross an empty map in one jump, so this is the A* limit
+    FAWorld::PathFindContext context(FAWorld::PathFindMode::AStar);
     bool isReachable = false;
-    auto path = FAWorld::pathFind(&level, nullptr, start, goal, isReachable, false);
+    auto path = FAWorld::pathFind(context, &level, nullptr, start, goal, isReachable, false);
 
     EXPECT_EQ(path.size(), 0);
     ASSERT_FALSE(isReachable);
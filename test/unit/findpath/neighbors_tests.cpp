@@ -2,6 +2,7 @@
 
 #include <faworld/findpath.h>
 
+#include <algorithm>
 #include <boost/make_unique.hpp>
 #include <gtest/gtest.h>
 
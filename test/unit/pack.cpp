@@ -0,0 +1,145 @@
+#include <boost/filesystem.hpp>
+#include <cstdio>
+#include <faio/pack.h>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+namespace bfs = boost::filesystem;
+
+class PackTest : public ::testing::Test
+{
+protected:
+    PackTest() : mPath((bfs::temp_directory_path() / bfs::unique_path("fapack-test-%%%%-%%%%.fapk")).string()) {}
+    ~PackTest()
+    {
+        boost::system::error_code error;
+        bfs::remove(mPath, error);
+    }
+
+    static std::vector<uint8_t> toBytes(const std::string& str) { return std::vector<uint8_t>(str.begin(), str.end()); }
+    static std::string toString(const FAIO::FileSpan& span) { return std::string(reinterpret_cast<const char*>(span.data()), span.size()); }
+
+    void writePack(bool compress)
+    {
+        FAIO::PackWriter writer(mPath, compress);
+        ASSERT_TRUE(writer.isOpen());
+
+        for (const auto& file : mFiles)
+        {
+            std::vector<uint8_t> contents = toBytes(file.second);
+            ASSERT_TRUE(writer.add(file.first, contents.data(), contents.size()));
+        }
+
+        ASSERT_TRUE(writer.finish());
+    }
+
+    void checkRoundTrip(bool compress)
+    {
+        writePack(compress);
+
+        auto pack = FAIO::Pack::open(mPath);
+        ASSERT_NE(pack, nullptr);
+        ASSERT_EQ(pack->numFiles(), mFiles.size());
+
+        for (const auto& file : mFiles)
+        {
+            ASSERT_TRUE(pack->contains(file.first));
+
+            FAIO::FileSpan span = pack->read(file.first);
+            ASSERT_TRUE(span.isValid());
+            ASSERT_EQ(toString(span), file.second);
+        }
+
+        ASSERT_FALSE(pack->contains("levels/l1data/missing.dun"));
+        ASSERT_FALSE(pack->read("levels/l1data/missing.dun").isValid());
+    }
+
+    std::string mPath;
+    std::vector<std::pair<std::string, std::string>> mFiles = {
+        {"levels/l1data/l1.cel", std::string(4096, 'a') + "the end"},
+        {"levels/l1data/l1.min", "0123456789"},
+        {"data/empty.txt", ""},
+    };
+};
+
+TEST_F(PackTest, TestRoundTrip) { checkRoundTrip(false); }
+
+TEST_F(PackTest, TestRoundTripCompressed)
+{
+    if (!FAIO::Pack::compressionSupported())
+        return;
+
+    checkRoundTrip(true);
+}
+
+TEST_F(PackTest, TestNormalisePath)
+{
+    ASSERT_EQ(FAIO::Pack::normalisePath("Levels\\L1Data\\L1.CEL"), "levels/l1data/l1.cel");
+    ASSERT_EQ(FAIO::Pack::normalisePath("./levels//l1data/l1.cel"), "levels/l1data/l1.cel");
+    ASSERT_EQ(FAIO::Pack::normalisePath("/levels/l1data/l1.cel"), "levels/l1data/l1.cel");
+
+    writePack(false);
+    auto pack = FAIO::Pack::open(mPath);
+    ASSERT_NE(pack, nullptr);
+
+    ASSERT_TRUE(pack->contains("LEVELS\\L1DATA\\L1.MIN"));
+    ASSERT_TRUE(pack->contains("./Levels/L1Data//l1.min"));
+    ASSERT_EQ(toString(pack->read("Levels\\l1data\\L1.min")), "0123456789");
+}
+
+TEST_F(PackTest, TestDuplicatePaths)
+{
+    std::vector<uint8_t> first = toBytes("first");
+    std::vector<uint8_t> second = toBytes("second");
+
+    {
+        FAIO::PackWriter writer(mPath, false);
+        ASSERT_TRUE(writer.add("data/file.txt", first.data(), first.size()));
+        ASSERT_FALSE(writer.add("Data\\File.txt", second.data(), second.size()));
+        ASSERT_TRUE(writer.finish());
+    }
+
+    auto pack = FAIO::Pack::open(mPath);
+    ASSERT_NE(pack, nullptr);
+    ASSERT_EQ(pack->numFiles(), 1u);
+    ASSERT_EQ(toString(pack->read("data/file.txt")), "first");
+}
+
+TEST_F(PackTest, TestTruncatedHeader)
+{
+    writePack(false);
+    bfs::resize_file(mPath, sizeof(FAIO::Pack::Header) - 1);
+
+    ASSERT_EQ(FAIO::Pack::open(mPath), nullptr);
+}
+
+TEST_F(PackTest, TestCorruptHeader)
+{
+    writePack(false);
+
+    FAIO::Pack::Header header;
+    FILE* f = fopen(mPath.c_str(), "r+b");
+    ASSERT_NE(f, nullptr);
+    ASSERT_EQ(fread(&header, sizeof(header), 1, f), 1u);
+
+    // the entry table running off the end of the file
+    header.numEntries = 1000000;
+    ASSERT_EQ(fseek(f, 0, SEEK_SET), 0);
+    ASSERT_EQ(fwrite(&header, sizeof(header), 1, f), 1u);
+    ASSERT_EQ(fclose(f), 0);
+
+    ASSERT_EQ(FAIO::Pack::open(mPath), nullptr);
+}
+
+TEST_F(PackTest, TestBadMagic)
+{
+    writePack(false);
+
+    FILE* f = fopen(mPath.c_str(), "r+b");
+    ASSERT_NE(f, nullptr);
+    ASSERT_EQ(fwrite("NOPE", 4, 1, f), 1u);
+    ASSERT_EQ(fclose(f), 0);
+
+    ASSERT_EQ(FAIO::Pack::open(mPath), nullptr);
+}